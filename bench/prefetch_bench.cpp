@@ -0,0 +1,58 @@
+// Lookup latency with and without MOMU_SKIP_LIST_PREFETCH, on lists larger
+// than the last-level cache. Build it from this directory once with
+// -DMOMU_SKIP_LIST_PREFETCH=1 and once without, and compare:
+//
+//   g++ -std=c++17 -O2 -DNDEBUG -I.. prefetch_bench.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "skip_list.h"
+
+using momu::skip_list::SkipList;
+
+namespace {
+
+constexpr size_t kEntries = 1000000;
+constexpr size_t kLookups = 300000;
+constexpr int kRounds = 7;
+
+// Best of kRounds, in nanoseconds per lookup of a present key.
+template <typename K>
+double time_lookups(const std::vector<K>& keys) {
+    SkipList<K, uint64_t> list(20, 1);
+    for (size_t i = 0; i < keys.size(); ++i) list.put(keys[i], i);
+
+    double best = 1e300;
+    size_t found = 0;
+    for (int round = 0; round < kRounds; ++round) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kLookups; ++i)
+            found += list.contains(keys[(i * 7919 + round) % keys.size()]);
+        const std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / kLookups);
+    }
+    if (found != kRounds * kLookups) std::printf("lookup missed a key\n");
+    return best;
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937_64 gen(3);
+    std::vector<uint64_t> ints(kEntries);
+    std::vector<std::string> strings(kEntries);
+    for (size_t i = 0; i < kEntries; ++i) {
+        ints[i] = gen();
+        strings[i] = "key:" + std::to_string(ints[i]);
+    }
+    std::printf("prefetch %d\n", MOMU_SKIP_LIST_PREFETCH);
+    std::printf("uint64 keys  %.0f ns/get\n", time_lookups(ints));
+    std::printf("string keys  %.0f ns/get\n", time_lookups(strings));
+}
@@ -0,0 +1,104 @@
+// Lookup latency under a skewed Zipf(0.99) workload, Balance::kRandomized
+// against Balance::kAccessBiased, on 1M keys inserted in random order. The
+// lists take turns over kRounds rounds and the best round of each counts.
+// Build from this directory:
+//
+//   g++ -std=c++17 -O2 -DNDEBUG -I.. zipf_bench.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "skip_list.h"
+
+using momu::skip_list::Balance;
+using momu::skip_list::SkipList;
+using momu::skip_list::SkipListOptions;
+
+namespace {
+
+constexpr int kEntries = 1000000;
+constexpr int kLookups = 5000000;
+constexpr int kWarmup = 1000000;
+constexpr int kRounds = 5;
+constexpr double kSkew = 0.99;
+
+// kWarmup + kLookups keys drawn from Zipf(kSkew) over the list's keys, with
+// ranks shuffled so the hot keys are spread across the list.
+std::vector<int> zipf_keys(std::mt19937& gen) {
+    std::vector<double> cdf(kEntries);
+    double sum = 0;
+    for (int i = 0; i < kEntries; ++i) {
+        sum += 1.0 / std::pow(i + 1, kSkew);
+        cdf[i] = sum;
+    }
+    std::vector<int> by_rank(kEntries);
+    for (int i = 0; i < kEntries; ++i) by_rank[i] = 2 * i;
+    std::shuffle(by_rank.begin(), by_rank.end(), gen);
+
+    std::uniform_real_distribution<double> uniform(0, sum);
+    std::vector<int> keys(kWarmup + kLookups);
+    for (auto& key : keys) {
+        const auto rank =
+            std::lower_bound(cdf.begin(), cdf.end(), uniform(gen)) -
+            cdf.begin();
+        key = by_rank[std::min<size_t>(rank, kEntries - 1)];
+    }
+    return keys;
+}
+
+std::unique_ptr<SkipList<int, int>> make_list(Balance balance,
+                                              std::mt19937& gen) {
+    SkipListOptions options;
+    options.balance = balance;
+    auto list = std::make_unique<SkipList<int, int>>(20, 1, options);
+    std::vector<int> order(kEntries);
+    for (int i = 0; i < kEntries; ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), gen);
+    for (int i : order) list->put(2 * i, i);
+    return list;
+}
+
+// Nanoseconds per lookup over one round, a kLookups / kRounds slice of the
+// keys after the warm-up ones.
+double time_round(SkipList<int, int>& list, const std::vector<int>& keys,
+                  int round) {
+    const size_t per_round = kLookups / kRounds;
+    const size_t first = kWarmup + round * per_round;
+    size_t found = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = first; i < first + per_round; ++i)
+        found += list.contains(keys[i]);
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (found != per_round) std::printf("lookup missed\n");
+    return elapsed.count() / per_round;
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 gen(7);
+    const auto keys = zipf_keys(gen);
+    auto randomized = make_list(Balance::kRandomized, gen);
+    auto biased = make_list(Balance::kAccessBiased, gen);
+    for (int i = 0; i < kWarmup; ++i) {
+        randomized->contains(keys[i]);
+        biased->contains(keys[i]);
+    }
+
+    // The two lists take turns, so drift in machine load hits both alike.
+    double best_randomized = 1e300;
+    double best_biased = 1e300;
+    for (int round = 0; round < kRounds; ++round) {
+        best_randomized =
+            std::min(best_randomized, time_round(*randomized, keys, round));
+        best_biased = std::min(best_biased, time_round(*biased, keys, round));
+    }
+    std::printf("randomized     %.0f ns/get\n", best_randomized);
+    std::printf("access-biased  %.0f ns/get\n", best_biased);
+}
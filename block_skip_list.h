@@ -0,0 +1,380 @@
+#ifndef MOMU_BLOCK_SKIP_LIST_H
+#define MOMU_BLOCK_SKIP_LIST_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Search blocks of 32- and 64-bit integer keys with SSE or AVX2 compares,
+// picked at run time from what the CPU supports. Define as 0 to disable.
+#ifndef MOMU_SKIP_LIST_SIMD
+#define MOMU_SKIP_LIST_SIMD 1
+#endif
+
+#if MOMU_SKIP_LIST_SIMD && defined(__x86_64__) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define MOMU_SKIP_LIST_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define MOMU_SKIP_LIST_X86_SIMD 0
+#endif
+
+namespace momu {
+namespace skip_list {
+
+// lower_bound over the first n of a block's sorted keys.
+template <typename K, typename = void>
+struct BlockSearch {
+    static size_t lower_bound(const K* keys, size_t n, const K& key) {
+        return std::lower_bound(keys, keys + n, key) - keys;
+    }
+};
+
+#if MOMU_SKIP_LIST_X86_SIMD
+// For 4- and 8-byte integers the position is the number of keys less than
+// key, counted a vector at a time without branching on the comparisons.
+// Unsigned keys are compared as signed after flipping the top bit. Loads may
+// run past n to the end of the vector, so keys must be readable up to n
+// rounded up to 32 bytes, as the keys of a block are.
+template <typename K>
+struct BlockSearch<K, std::enable_if_t<std::is_integral_v<K> &&
+                                       (sizeof(K) == 4 || sizeof(K) == 8)>> {
+    static size_t lower_bound(const K* keys, size_t n, const K& key) {
+        static const auto search = pick();
+        return search(keys, n, key);
+    }
+
+   private:
+    using Search = size_t (*)(const K*, size_t, const K&);
+
+    static constexpr bool kWide = sizeof(K) == 8;
+    static constexpr uint64_t kBias =
+        std::is_signed_v<K> ? 0 : uint64_t{1} << (8 * sizeof(K) - 1);
+    // kBias as the lane types of the set1 intrinsics, so that 2^31 is not
+    // narrowed to int implicitly.
+    static constexpr long long kBias64 = static_cast<long long>(kBias);
+    static constexpr int kBias32 =
+        static_cast<int>(static_cast<uint32_t>(kBias));
+
+    static Search pick() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return avx2_lower_bound;
+        if (__builtin_cpu_supports("sse4.2")) return sse_lower_bound;
+        return scalar_lower_bound;
+    }
+
+    static size_t scalar_lower_bound(const K* keys, size_t n, const K& key) {
+        return std::lower_bound(keys, keys + n, key) - keys;
+    }
+
+    // Keeps the low bits of mask that stand for keys before n.
+    static uint32_t below(uint32_t mask, size_t first, size_t n,
+                          size_t lanes) {
+        return n - first >= lanes ? mask : mask & ((1u << (n - first)) - 1);
+    }
+
+    __attribute__((target("avx2"))) static size_t avx2_lower_bound(
+        const K* keys, size_t n, const K& key) {
+        constexpr size_t kLanes = 32 / sizeof(K);
+        const __m256i bias = kWide ? _mm256_set1_epi64x(kBias64)
+                                   : _mm256_set1_epi32(kBias32);
+        const __m256i needle = _mm256_xor_si256(
+            kWide ? _mm256_set1_epi64x(key) : _mm256_set1_epi32(key), bias);
+        size_t count = 0;
+        for (size_t i = 0; i < n; i += kLanes) {
+            const __m256i chunk = _mm256_xor_si256(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)),
+                bias);
+            const uint32_t less =
+                kWide ? _mm256_movemask_pd(_mm256_castsi256_pd(
+                            _mm256_cmpgt_epi64(needle, chunk)))
+                      : _mm256_movemask_ps(_mm256_castsi256_ps(
+                            _mm256_cmpgt_epi32(needle, chunk)));
+            count += __builtin_popcount(below(less, i, n, kLanes));
+        }
+        return count;
+    }
+
+    __attribute__((target("sse4.2"))) static size_t sse_lower_bound(
+        const K* keys, size_t n, const K& key) {
+        constexpr size_t kLanes = 16 / sizeof(K);
+        const __m128i bias =
+            kWide ? _mm_set1_epi64x(kBias64) : _mm_set1_epi32(kBias32);
+        const __m128i needle = _mm_xor_si128(
+            kWide ? _mm_set1_epi64x(key) : _mm_set1_epi32(key), bias);
+        size_t count = 0;
+        for (size_t i = 0; i < n; i += kLanes) {
+            const __m128i chunk = _mm_xor_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)),
+                bias);
+            const uint32_t less =
+                kWide ? _mm_movemask_pd(
+                            _mm_castsi128_pd(_mm_cmpgt_epi64(needle, chunk)))
+                      : _mm_movemask_ps(
+                            _mm_castsi128_ps(_mm_cmpgt_epi32(needle, chunk)));
+            count += __builtin_popcount(below(less, i, n, kLanes));
+        }
+        return count;
+    }
+};
+#endif
+
+// A run of up to kCapacity entries, sorted by key, with one tower for all of
+// them. Keys and values sit in separate inline arrays, so a search inside a
+// block and a scan over it read consecutive keys.
+template <typename K, typename V>
+struct Block {
+    static constexpr size_t kCapacity = 32;
+
+    explicit Block(uint8_t level) : forward_(level + 1) {}
+
+    Block(const Block&) = delete;
+    Block& operator=(const Block&) = delete;
+
+    // The tower is indexed by the first key.
+    const K& first_key() const { return keys_[0]; }
+
+    // Position of the first key not less than key, or size_.
+    size_t lower_bound(const K& key) const {
+        return BlockSearch<K>::lower_bound(keys_, size_, key);
+    }
+
+    void insert_at(size_t pos, const K& key, const V& value) {
+        std::move_backward(keys_ + pos, keys_ + size_, keys_ + size_ + 1);
+        std::move_backward(values_ + pos, values_ + size_, values_ + size_ + 1);
+        keys_[pos] = key;
+        values_[pos] = value;
+        ++size_;
+    }
+
+    void erase_at(size_t pos) {
+        std::move(keys_ + pos + 1, keys_ + size_, keys_ + pos);
+        std::move(values_ + pos + 1, values_ + size_, values_ + pos);
+        --size_;
+    }
+
+    // Moves the entries from pos on to the end of other.
+    void move_tail(size_t pos, Block& other) {
+        std::move(keys_ + pos, keys_ + size_, other.keys_ + other.size_);
+        std::move(values_ + pos, values_ + size_, other.values_ + other.size_);
+        other.size_ += size_ - pos;
+        size_ = pos;
+    }
+
+    alignas(32) K keys_[kCapacity];
+    V values_[kCapacity];
+    size_t size_{0};
+    std::vector<std::shared_ptr<Block>> forward_;
+};
+
+// Unrolled skip list: the same interface as SkipList for the operations it
+// supports, over blocks of up to Block::kCapacity entries instead of single
+// nodes. Towers link blocks, so there is one tower per block rather than
+// per entry, a search hops between blocks about log2(n / kCapacity) times
+// and finishes with a binary search inside one, and a range scan reads
+// keys block by block. A full block splits in half on insertion, and a
+// block that falls below a quarter full merges with its successor when
+// the two fit in one.
+template <typename K, typename V>
+class BlockSkipList {
+   public:
+    explicit BlockSkipList(uint8_t max_level,
+                           unsigned int seed = std::random_device{}())
+        : max_level_(std::min(max_level, kMaxLevelLimit)),
+          header_(std::make_unique<Block<K, V>>(max_level_)),
+          gen_(seed),
+          distribution_(0.5) {}
+
+    // Blocks are released front to back, so a long list does not recurse
+    // through the chain of shared_ptr destructors.
+    ~BlockSkipList() {
+        auto block = std::move(header_->forward_[0]);
+        while (block) {
+            auto next = std::move(block->forward_[0]);
+            block->forward_.clear();
+            block = std::move(next);
+        }
+    }
+
+    BlockSkipList(const BlockSkipList&) = delete;
+    BlockSkipList& operator=(const BlockSkipList&) = delete;
+
+    void put(const K& key, const V& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<Block<K, V>*> preds(max_level_ + 1);
+        Block<K, V>* block = find_block(key, preds);
+        if (!block) {
+            // The list is empty.
+            block = link_block(header_.get(), preds);
+        }
+        const size_t pos = block->lower_bound(key);
+        if (pos < block->size_ && block->keys_[pos] == key) {
+            block->values_[pos] = value;
+            return;
+        }
+        if (block->size_ == Block<K, V>::kCapacity) {
+            auto* right = link_block(block, preds);
+            block->move_tail(Block<K, V>::kCapacity / 2, *right);
+            if (pos > block->size_) {
+                right->insert_at(pos - block->size_, key, value);
+                ++element_count_;
+                return;
+            }
+        }
+        block->insert_at(pos, key, value);
+        ++element_count_;
+    }
+
+    std::optional<V> get(const K& key) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Block<K, V>* block = find_block(key);
+        if (!block) return std::nullopt;
+        const size_t pos = block->lower_bound(key);
+        if (pos == block->size_ || !(block->keys_[pos] == key))
+            return std::nullopt;
+        return block->values_[pos];
+    }
+
+    bool contains(const K& key) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Block<K, V>* block = find_block(key);
+        if (!block) return false;
+        const size_t pos = block->lower_bound(key);
+        return pos < block->size_ && block->keys_[pos] == key;
+    }
+
+    bool remove(const K& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Block<K, V>* block = find_block(key);
+        if (!block) return false;
+        const size_t pos = block->lower_bound(key);
+        if (pos == block->size_ || !(block->keys_[pos] == key)) return false;
+        --element_count_;
+        if (block->size_ == 1) {
+            unlink_block(block);
+            return true;
+        }
+        block->erase_at(pos);
+
+        auto next = block->forward_[0];
+        if (block->size_ < Block<K, V>::kCapacity / 4 && next &&
+            block->size_ + next->size_ <= Block<K, V>::kCapacity) {
+            // Unlinked while it still has its first key to be found by.
+            unlink_block(next.get());
+            next->move_tail(0, *block);
+        }
+        return true;
+    }
+
+    // Entries with lo <= key < hi, in order.
+    std::vector<std::pair<K, V>> range(const K& lo, const K& hi) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::pair<K, V>> entries;
+        const Block<K, V>* block = find_block(lo);
+        if (!block) return entries;
+        for (size_t pos = block->lower_bound(lo); block;
+             block = block->forward_[0].get(), pos = 0) {
+            for (; pos < block->size_; ++pos) {
+                if (!(block->keys_[pos] < hi)) return entries;
+                entries.emplace_back(block->keys_[pos], block->values_[pos]);
+            }
+        }
+        return entries;
+    }
+
+    size_t size() const { return element_count_; }
+    bool empty() const { return element_count_ == 0; }
+
+   private:
+    static constexpr uint8_t kMaxLevelLimit = 32;
+
+    // Returns the block that holds key if any block does: the last one whose
+    // first key is not greater than key, or else the first block, which is
+    // null when the list is empty. preds receives the last block on each
+    // level whose first key is not greater than key, or the header.
+    Block<K, V>* find_block(const K& key,
+                            std::vector<Block<K, V>*>& preds) const {
+        Block<K, V>* cur = header_.get();
+        for (int i = current_max_level_; i >= 0; --i) {
+            cur = move_forward_in_level(cur, i, key);
+            preds[i] = cur;
+        }
+        for (int i = current_max_level_ + 1; i <= max_level_; ++i)
+            preds[i] = header_.get();
+        return cur == header_.get() ? cur->forward_[0].get() : cur;
+    }
+
+    Block<K, V>* find_block(const K& key) const {
+        Block<K, V>* cur = header_.get();
+        for (int i = current_max_level_; i >= 0; --i)
+            cur = move_forward_in_level(cur, i, key);
+        return cur == header_.get() ? cur->forward_[0].get() : cur;
+    }
+
+    Block<K, V>* move_forward_in_level(Block<K, V>* cur, int lvl,
+                                       const K& key) const {
+        while (auto* nxt = cur->forward_[lvl].get()) {
+            if (key < nxt->first_key()) break;
+            cur = nxt;
+        }
+        return cur;
+    }
+
+    // Links a new empty block right after block, whose predecessors from a
+    // search are preds. Where block's own tower reaches, it is the new
+    // block's predecessor.
+    Block<K, V>* link_block(Block<K, V>* block,
+                            const std::vector<Block<K, V>*>& preds) {
+        const uint8_t lvl = generate_random_level();
+        auto fresh = std::make_shared<Block<K, V>>(lvl);
+        current_max_level_ = std::max(current_max_level_, lvl);
+        for (uint8_t i = 0; i <= lvl; ++i) {
+            auto* pred = i < block->forward_.size() ? block : preds[i];
+            fresh->forward_[i] = std::move(pred->forward_[i]);
+            pred->forward_[i] = fresh;
+        }
+        return fresh.get();
+    }
+
+    // Unlinks block, found on each level of its tower by its first key, which
+    // no other block shares. It is freed unless the caller still owns it.
+    void unlink_block(Block<K, V>* block) {
+        Block<K, V>* cur = header_.get();
+        for (int i = current_max_level_; i >= 0; --i) {
+            while (auto* nxt = cur->forward_[i].get()) {
+                if (!(nxt->first_key() < block->first_key())) break;
+                cur = nxt;
+            }
+            if (cur->forward_[i].get() == block)
+                cur->forward_[i] = std::move(block->forward_[i]);
+        }
+        while (current_max_level_ > 0 &&
+               !header_->forward_[current_max_level_])
+            --current_max_level_;
+    }
+
+    uint8_t generate_random_level() {
+        uint8_t lvl = 0;
+        while (distribution_(gen_) && lvl < max_level_) ++lvl;
+        return lvl;
+    }
+
+    uint8_t max_level_;
+    uint8_t current_max_level_{0};
+    size_t element_count_{0};
+    std::unique_ptr<Block<K, V>> header_;
+    std::mt19937 gen_;
+    std::bernoulli_distribution distribution_;
+    mutable std::mutex mutex_;
+};
+
+}  // namespace skip_list
+}  // namespace momu
+
+#endif  // MOMU_BLOCK_SKIP_LIST_H
\ No newline at end of file
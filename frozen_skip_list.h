@@ -0,0 +1,189 @@
+#ifndef MOMU_FROZEN_SKIP_LIST_H
+#define MOMU_FROZEN_SKIP_LIST_H
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace momu {
+namespace skip_list {
+
+// Immutable snapshot of a SkipList, from SkipList::freeze(). Keys and values
+// sit in two sorted arrays, and a copy of the keys in Eytzinger (BFS) order
+// serves as the search index: the first levels of the implicit tree share
+// a few cache lines, and the next lines down can be prefetched several
+// levels ahead. Arithmetic keys get a learned index instead: a piecewise
+// linear map from key to position, accurate to within kMaxError positions,
+// so a lookup is one multiply plus a binary search over a few dozen keys.
+// Nothing changes after construction, so every method is const and safe to
+// call from any number of threads without locking.
+template <typename K, typename V>
+class FrozenSkipList {
+   public:
+    FrozenSkipList() = default;
+
+    // keys must be sorted; equal keys are allowed and keep their order.
+    FrozenSkipList(std::vector<K> keys, std::vector<V> values)
+        : keys_(std::move(keys)), values_(std::move(values)) {
+        if constexpr (kLearned) {
+            build_segments();
+        } else {
+            tree_.resize(keys_.size() + 1);
+            position_.resize(keys_.size() + 1);
+            build(0, 1);
+        }
+    }
+
+    size_t size() const { return keys_.size(); }
+    bool empty() const { return keys_.empty(); }
+
+    // Position of the first key not less than key, or size().
+    size_t lower_bound(const K& key) const {
+        if constexpr (kLearned) return predicted_lower_bound(key);
+        const size_t n = keys_.size();
+        size_t k = 1;
+        while (k <= n) {
+            // 16 descendants down is four levels ahead.
+            prefetch(tree_.data() + std::min(16 * k, n));
+            k = 2 * k + (tree_[k] < key);
+        }
+        // The path went right past the answer and then left every level
+        // since; undo those turns and the last left one.
+        while (k & 1) k >>= 1;
+        k >>= 1;
+        return k == 0 ? n : position_[k];
+    }
+
+    std::optional<V> get(const K& key) const {
+        const size_t pos = lower_bound(key);
+        if (pos == keys_.size() || !(keys_[pos] == key)) return std::nullopt;
+        return values_[pos];
+    }
+
+    bool contains(const K& key) const {
+        const size_t pos = lower_bound(key);
+        return pos != keys_.size() && keys_[pos] == key;
+    }
+
+    // Entries with lo <= key < hi, in order.
+    std::vector<std::pair<K, V>> range(const K& lo, const K& hi) const {
+        std::vector<std::pair<K, V>> entries;
+        for (size_t pos = lower_bound(lo);
+             pos < keys_.size() && keys_[pos] < hi; ++pos)
+            entries.emplace_back(keys_[pos], values_[pos]);
+        return entries;
+    }
+
+    // Sorted arrays, for scans by position.
+    const std::vector<K>& keys() const { return keys_; }
+    const std::vector<V>& values() const { return values_; }
+
+   private:
+    static constexpr bool kLearned = std::is_arithmetic_v<K>;
+    static constexpr size_t kMaxError = 32;
+
+    // Keys from first on lie within kMaxError positions of
+    // start + slope * (key - first), up to the next segment's first key.
+    struct Segment {
+        size_t start;
+        double slope;
+    };
+
+    // Greedy shrinking cone, as in the PGM index: extend the segment while
+    // some slope through its first point keeps every point so far within
+    // kMaxError, then start a new one. One pass, O(n).
+    void build_segments() {
+        for (size_t first = 0; first < keys_.size();) {
+            const double x0 = static_cast<double>(keys_[first]);
+            double lo = 0;
+            double hi = std::numeric_limits<double>::infinity();
+            size_t end = first + 1;
+            for (; end < keys_.size(); ++end) {
+                const double dx = static_cast<double>(keys_[end]) - x0;
+                const double dy = static_cast<double>(end - first);
+                if (dx <= 0) {
+                    if (dy > kMaxError) break;
+                    continue;
+                }
+                const double new_lo = std::max(lo, (dy - kMaxError) / dx);
+                const double new_hi = std::min(hi, (dy + kMaxError) / dx);
+                if (new_lo > new_hi) break;
+                lo = new_lo;
+                hi = new_hi;
+            }
+            segment_keys_.push_back(keys_[first]);
+            segments_.push_back(
+                {first, hi == std::numeric_limits<double>::infinity()
+                            ? lo
+                            : (lo + hi) / 2});
+            first = end;
+        }
+    }
+
+    size_t predicted_lower_bound(const K& key) const {
+        const size_t n = keys_.size();
+        auto seg = std::upper_bound(segment_keys_.begin(), segment_keys_.end(),
+                                    key);
+        if (seg == segment_keys_.begin()) return 0;
+        const size_t s = seg - segment_keys_.begin() - 1;
+        const size_t begin = segments_[s].start;
+        const size_t end =
+            s + 1 < segments_.size() ? segments_[s + 1].start : n;
+
+        const double guess =
+            begin + segments_[s].slope * (static_cast<double>(key) -
+                                          static_cast<double>(keys_[begin]));
+        const auto clamp = [&](double pos) {
+            if (!(pos > begin)) return begin;
+            if (!(pos < end)) return end;
+            return static_cast<size_t>(pos);
+        };
+        const size_t lo = clamp(guess - kMaxError - 1);
+        const size_t hi = clamp(guess + kMaxError + 2);
+        const auto base = keys_.begin();
+        auto it = std::lower_bound(base + lo, base + hi, key);
+        // Rounding on keys too wide for a double, or a run of equal keys
+        // split between segments, can put the answer outside the window.
+        if ((it == base + lo && lo > 0 && !(keys_[lo - 1] < key)) ||
+            (it == base + hi && hi < end))
+            it = std::lower_bound(base, base + end, key);
+        return it - base;
+    }
+
+    // Fills the subtree rooted at node k with keys from position pos on, in
+    // order, and returns the position after the last key it took.
+    size_t build(size_t pos, size_t k) {
+        if (k >= tree_.size()) return pos;
+        pos = build(pos, 2 * k);
+        tree_[k] = keys_[pos];
+        position_[k] = pos++;
+        return build(pos, 2 * k + 1);
+    }
+
+    static void prefetch(const void* addr) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(addr);
+#else
+        (void)addr;
+#endif
+    }
+
+    std::vector<K> keys_;
+    std::vector<V> values_;
+    // Keys in Eytzinger order from index 1, and each one's sorted position.
+    std::vector<K> tree_;
+    std::vector<size_t> position_;
+    // The learned index: each segment's first key, kept apart for a compact
+    // binary search, and its model.
+    std::vector<K> segment_keys_;
+    std::vector<Segment> segments_;
+};
+
+}  // namespace skip_list
+}  // namespace momu
+
+#endif  // MOMU_FROZEN_SKIP_LIST_H
@@ -0,0 +1,227 @@
+#ifndef MOMU_PAGED_SKIP_LIST_H
+#define MOMU_PAGED_SKIP_LIST_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace momu {
+namespace skip_list {
+
+// Skip list for trivially copyable keys and values, with the same interface
+// as SkipList for the operations it supports. Nodes are slots in pages of
+// kPageSize, laid out as structure of arrays: keys, values, tower heights
+// and tower offsets each have an array of their own, and the towers of a
+// page share one array of links. A node is named by a 32-bit id, its page
+// and slot, instead of a pointer, and a link is such an id. A search reads
+// only links and keys, and no node carries an allocation or a reference
+// count of its own. Slots of removed nodes are reused by later nodes of the
+// same height, tower included. Holds up to 2^32 - 1 entries.
+template <typename K, typename V>
+class PagedSkipList {
+    static_assert(std::is_trivially_copyable_v<K> &&
+                      std::is_trivially_copyable_v<V>,
+                  "PagedSkipList needs trivially copyable keys and values");
+
+   public:
+    explicit PagedSkipList(uint8_t max_level,
+                           unsigned int seed = std::random_device{}())
+        : max_level_(std::min(max_level, kMaxLevelLimit)),
+          free_(max_level_ + 1),
+          gen_(seed),
+          distribution_(0.5) {
+        allocate(max_level_);
+    }
+
+    PagedSkipList(const PagedSkipList&) = delete;
+    PagedSkipList& operator=(const PagedSkipList&) = delete;
+
+    void put(const K& key, const V& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<uint32_t> preds(max_level_ + 1, kHeader);
+        const uint32_t next = find_predecessors(key, preds);
+        if (next != kNil && key_of(next) == key) {
+            value_of(next) = value;
+            return;
+        }
+
+        const uint8_t lvl = generate_random_level();
+        const uint32_t node = allocate(lvl);
+        key_of(node) = key;
+        value_of(node) = value;
+        current_max_level_ = std::max(current_max_level_, lvl);
+        uint32_t* tower = tower_of(node);
+        for (uint8_t i = 0; i <= lvl; ++i) {
+            uint32_t* pred = tower_of(preds[i]);
+            tower[i] = pred[i];
+            pred[i] = node;
+        }
+        ++element_count_;
+    }
+
+    std::optional<V> get(const K& key) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const uint32_t node = find_node(key);
+        if (node == kNil) return std::nullopt;
+        return value_of(node);
+    }
+
+    bool contains(const K& key) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return find_node(key) != kNil;
+    }
+
+    bool remove(const K& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<uint32_t> preds(max_level_ + 1, kHeader);
+        const uint32_t node = find_predecessors(key, preds);
+        if (node == kNil || !(key_of(node) == key)) return false;
+
+        const uint8_t height = height_of(node);
+        const uint32_t* tower = tower_of(node);
+        for (uint8_t i = 0; i < height; ++i) {
+            uint32_t* pred = tower_of(preds[i]);
+            if (pred[i] == node) pred[i] = tower[i];
+        }
+        free_[height - 1].push_back(node);
+        while (current_max_level_ > 0 &&
+               tower_of(kHeader)[current_max_level_] == kNil)
+            --current_max_level_;
+        --element_count_;
+        return true;
+    }
+
+    // Entries with lo <= key < hi, in order.
+    std::vector<std::pair<K, V>> range(const K& lo, const K& hi) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::pair<K, V>> entries;
+        for (uint32_t node = lower_bound(lo);
+             node != kNil && key_of(node) < hi; node = tower_of(node)[0])
+            entries.emplace_back(key_of(node), value_of(node));
+        return entries;
+    }
+
+    size_t size() const { return element_count_; }
+    bool empty() const { return element_count_ == 0; }
+
+   private:
+    static constexpr uint8_t kMaxLevelLimit = 32;
+    static constexpr uint32_t kPageBits = 12;
+    static constexpr uint32_t kPageSize = uint32_t{1} << kPageBits;
+    // The header takes id 0. It is never anyone's successor, so 0 doubles as
+    // the null link.
+    static constexpr uint32_t kHeader = 0;
+    static constexpr uint32_t kNil = 0;
+
+    struct Page {
+        Page() { links_.reserve(2 * kPageSize); }
+
+        K keys_[kPageSize];
+        V values_[kPageSize];
+        // Where each slot's tower starts in links_, and its height.
+        uint32_t towers_[kPageSize];
+        uint8_t heights_[kPageSize];
+        std::vector<uint32_t> links_;
+    };
+
+    Page& page_of(uint32_t node) const { return *pages_[node >> kPageBits]; }
+    static uint32_t slot_of(uint32_t node) { return node & (kPageSize - 1); }
+
+    K& key_of(uint32_t node) const {
+        return page_of(node).keys_[slot_of(node)];
+    }
+    V& value_of(uint32_t node) const {
+        return page_of(node).values_[slot_of(node)];
+    }
+    uint8_t height_of(uint32_t node) const {
+        return page_of(node).heights_[slot_of(node)];
+    }
+    // Valid until the next allocate().
+    uint32_t* tower_of(uint32_t node) const {
+        Page& page = page_of(node);
+        return page.links_.data() + page.towers_[slot_of(node)];
+    }
+
+    // Returns the first node not less than key, or kNil, and fills preds with
+    // its predecessor on each level up to current_max_level_.
+    uint32_t find_predecessors(const K& key,
+                               std::vector<uint32_t>& preds) const {
+        uint32_t cur = kHeader;
+        for (int i = current_max_level_; i >= 0; --i) {
+            cur = move_forward_in_level(cur, i, key);
+            preds[i] = cur;
+        }
+        return tower_of(cur)[0];
+    }
+
+    uint32_t lower_bound(const K& key) const {
+        uint32_t cur = kHeader;
+        for (int i = current_max_level_; i >= 0; --i)
+            cur = move_forward_in_level(cur, i, key);
+        return tower_of(cur)[0];
+    }
+
+    uint32_t find_node(const K& key) const {
+        const uint32_t node = lower_bound(key);
+        return node != kNil && key_of(node) == key ? node : kNil;
+    }
+
+    uint32_t move_forward_in_level(uint32_t cur, int lvl, const K& key) const {
+        for (uint32_t nxt; (nxt = tower_of(cur)[lvl]) != kNil;) {
+            if (!(key_of(nxt) < key)) break;
+            cur = nxt;
+        }
+        return cur;
+    }
+
+    // Takes a slot for a node of level lvl, reusing a freed one of the same
+    // height if there is one.
+    uint32_t allocate(uint8_t lvl) {
+        auto& reusable = free_[lvl];
+        if (!reusable.empty()) {
+            const uint32_t node = reusable.back();
+            reusable.pop_back();
+            return node;
+        }
+        // One more slot would wrap the id to 0, the header and the null link.
+        if (slot_count_ == UINT32_MAX)
+            throw std::length_error("PagedSkipList is full");
+        if (slot_count_ == pages_.size() * kPageSize)
+            pages_.push_back(std::make_unique<Page>());
+        const uint32_t node = slot_count_++;
+        Page& page = page_of(node);
+        page.towers_[slot_of(node)] = static_cast<uint32_t>(page.links_.size());
+        page.heights_[slot_of(node)] = lvl + 1;
+        page.links_.resize(page.links_.size() + lvl + 1, kNil);
+        return node;
+    }
+
+    uint8_t generate_random_level() {
+        uint8_t lvl = 0;
+        while (distribution_(gen_) && lvl < max_level_) ++lvl;
+        return lvl;
+    }
+
+    uint8_t max_level_;
+    uint8_t current_max_level_{0};
+    size_t element_count_{0};
+    uint32_t slot_count_{0};
+    std::vector<std::unique_ptr<Page>> pages_;
+    // Freed slots by tower height minus one.
+    std::vector<std::vector<uint32_t>> free_;
+    std::mt19937 gen_;
+    std::bernoulli_distribution distribution_;
+    mutable std::mutex mutex_;
+};
+
+}  // namespace skip_list
+}  // namespace momu
+
+#endif  // MOMU_PAGED_SKIP_LIST_H
\ No newline at end of file
@@ -1,115 +1,1409 @@
 #ifndef MOMU_SKIP_LIST_H
 #define MOMU_SKIP_LIST_H
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <random>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "frozen_skip_list.h"
+
+// Prefetch the tower of each node while its key is being compared, so the link
+// load for the next hop overlaps with the comparison instead of following it.
+// Applies to non-integral keys only: integral keys are compared against the
+// copy cached in the link, which leaves no comparison to overlap with, and the
+// node a walk moves onto is loaded right away.
+// Off by default: bench/prefetch_bench.cpp has not yet shown it beating no
+// prefetch. Define as 1 to enable. The prefetches that get_many's interleaved
+// lookups and FrozenSkipList's search are built around do not depend on it.
+#ifndef MOMU_SKIP_LIST_PREFETCH
+#define MOMU_SKIP_LIST_PREFETCH 0
+#endif
+
 namespace momu {
 namespace skip_list {
 
+// Order-preserving 8-byte summary of a key. Nodes cache it inline so most
+// comparisons during a search are a single integer compare on the node's own
+// cache line; the full key is only consulted when two prefixes tie.
+template <typename K>
+struct KeyPrefix {
+    static constexpr bool kEnabled = false;
+    static uint64_t make(const K&) { return 0; }
+};
+
+template <>
+struct KeyPrefix<std::string> {
+    static constexpr bool kEnabled = true;
+    // First 8 bytes packed big-endian and zero padded, so unsigned integer
+    // order matches std::string's unsigned byte-wise order.
+    static uint64_t make(const std::string& key) {
+        uint64_t prefix = 0;
+        for (size_t i = 0; i < sizeof(prefix); ++i) {
+            prefix <<= 8;
+            if (i < key.size()) prefix |= static_cast<unsigned char>(key[i]);
+        }
+        return prefix;
+    }
+};
+
+template <typename K, bool = KeyPrefix<K>::kEnabled>
+struct NodePrefix {
+    NodePrefix() = default;
+    explicit NodePrefix(const K&) {}
+};
+
+template <typename K>
+struct NodePrefix<K, true> {
+    NodePrefix() = default;
+    explicit NodePrefix(const K& key) : prefix_(KeyPrefix<K>::make(key)) {}
+
+    uint64_t prefix_{0};
+};
+
+template <typename K, typename = void>
+struct IsHashable : std::false_type {};
+
+template <typename K>
+struct IsHashable<
+    K, std::void_t<decltype(std::hash<K>{}(std::declval<const K&>()))>>
+    : std::true_type {};
+
 template <typename K, typename V>
-struct Node {
+struct Node : NodePrefix<K> {
+    // Integral keys are copied into the links that point at their nodes.
+    static constexpr bool kCachesKeys = std::is_integral_v<K>;
+
+    // Owning pointer to the next node that keeps a copy of its key beside
+    // it, so a search compares against the link it already holds and only
+    // loads the nodes it moves to. A null pointer carries the largest key as
+    // a sentinel that ends every walk, which saves searches a null check.
+    class KeyedNext {
+       public:
+        KeyedNext() = default;
+        KeyedNext(std::nullptr_t) {}
+        KeyedNext(std::shared_ptr<Node> node)
+            : key_(node ? node->key_ : kEnd), node_(std::move(node)) {}
+
+        KeyedNext(const KeyedNext&) = default;
+        KeyedNext(KeyedNext&& other) noexcept
+            : key_(other.key_), node_(std::move(other.node_)) {
+            other.key_ = kEnd;
+        }
+        KeyedNext& operator=(const KeyedNext&) = default;
+        KeyedNext& operator=(KeyedNext&& other) noexcept {
+            key_ = other.key_;
+            node_ = std::move(other.node_);
+            if (&other != this) other.key_ = kEnd;
+            return *this;
+        }
+
+        // Hands over the node, leaving this pointer null.
+        operator std::shared_ptr<Node>() && {
+            key_ = kEnd;
+            return std::move(node_);
+        }
+
+        Node* get() const { return node_.get(); }
+        Node* operator->() const { return node_.get(); }
+        explicit operator bool() const { return node_ != nullptr; }
+        const K& key() const { return key_; }
+
+       private:
+        static constexpr K kEnd = std::numeric_limits<K>::max();
+
+        K key_{kEnd};
+        std::shared_ptr<Node> node_;
+    };
+
+    // A forward pointer and its width, the number of level-0 steps it covers.
+    // A null pointer spans to one past the last node.
+    struct Link {
+        std::conditional_t<kCachesKeys, KeyedNext, std::shared_ptr<Node>> next_;
+        size_t span_{0};
+    };
+
     Node() = default;
     Node(const K& key, const V& value, uint8_t level)
-        : key_(key), value_(value), forward_(level + 1) {}
+        : NodePrefix<K>(key),
+          key_(key),
+          value_(value),
+          forward_(level + 1) {}
 
     Node(const Node&) = delete;
     Node& operator=(const Node&) = delete;
 
     K key_;
     V value_;
-    std::vector<std::shared_ptr<Node<K, V>>> forward_;
+    std::vector<Link> forward_;
+};
+
+// Counting Bloom filter over keys. It may call an absent key present, but
+// never the reverse. Counters stop at 255 and then stay put, so removals
+// cannot introduce false negatives. std::hash<K> is only needed once it is
+// used.
+template <typename K>
+class CountingBloomFilter {
+   public:
+    // Clears the filter and sizes it for about capacity keys, at which point
+    // around 1.2% of absent keys pass.
+    void reset(size_t capacity) {
+        size_t slots = 64;
+        while (slots < capacity * kCountersPerKey) slots <<= 1;
+        counters_.assign(slots, 0);
+    }
+
+    size_t capacity() const { return counters_.size() / kCountersPerKey; }
+
+    void insert(const K& key) {
+        for_each_slot(key, [&](size_t slot) {
+            if (counters_[slot] != UINT8_MAX) ++counters_[slot];
+        });
+    }
+
+    void erase(const K& key) {
+        for_each_slot(key, [&](size_t slot) {
+            if (counters_[slot] != 0 && counters_[slot] != UINT8_MAX)
+                --counters_[slot];
+        });
+    }
+
+    bool may_contain(const K& key) const {
+        bool present = true;
+        for_each_slot(key, [&](size_t slot) {
+            present = present && counters_[slot] != 0;
+        });
+        return present;
+    }
+
+   private:
+    static constexpr size_t kCountersPerKey = 10;
+    static constexpr size_t kHashes = 4;
+
+    // Double hashing over a mixed std::hash, since the standard hash of an
+    // integer is often the integer itself.
+    template <typename F>
+    void for_each_slot(const K& key, F&& f) const {
+        uint64_t h = std::hash<K>{}(key);
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        const size_t mask = counters_.size() - 1;
+        const uint64_t step = (h >> 32) | 1;
+        for (size_t i = 0; i < kHashes; ++i, h += step) f(h & mask);
+    }
+
+    std::vector<uint8_t> counters_;
+};
+
+// What a list's negative lookup filter saved, from SkipList::filter_stats().
+struct FilterStats {
+    // Lookups the filter answered as absent without a search.
+    size_t skipped{0};
+    // Lookups that passed the filter and found their key.
+    size_t passed{0};
+    // Lookups that passed the filter and still missed.
+    size_t false_positives{0};
+};
+
+// Shape of a list's towers, as reported by SkipList::balance_stats().
+struct BalanceStats {
+    size_t size{0};
+    // Nodes whose tower reaches each level. A well balanced list roughly
+    // halves the count from one level to the next.
+    std::vector<size_t> nodes_per_level;
+    // Forward hops taken by the longest search over all keys.
+    size_t longest_search{0};
+    // Most nodes of height exactly i - 1 between two consecutive nodes
+    // reaching level i, over all levels, counting the header as the first of
+    // them. Balance::kDeterministic keeps it at three at most.
+    size_t widest_gap{0};
+};
+
+// How a list decides the height of each tower.
+enum class Balance {
+    // Coin flips, O(log n) expected per operation.
+    kRandomized,
+    // A 1-2-3 skip list: between two consecutive nodes at a level there are
+    // always one to three nodes of the level below, so every search, put and
+    // remove is O(log n) in the worst case.
+    kDeterministic,
+    // Randomized, plus towers of frequently looked up nodes grow with their
+    // lookup counts, and a lookup stops at the first level holding its key,
+    // so hot keys are found near the top. One in 16 hits is counted, in a
+    // hash table of its own, and the counts are halved every n lookups,
+    // lowering towers whose keys have cooled off. Lookups answered by
+    // hash_index never reach the towers and are not counted.
+    kAccessBiased,
+};
+
+struct SkipListOptions {
+    Balance balance{Balance::kRandomized};
+    // Keep every put as its own entry. Entries with equal keys stay in
+    // insertion order; get, remove and the other single-key operations act on
+    // the first of them.
+    bool multimap{false};
+    // Keep a hash table from key to node beside the towers, so point lookups
+    // and updates of existing keys skip the descent. Ignored when std::hash
+    // does not support K. Since get and contains then skip the towers,
+    // Balance::kAccessBiased only counts lookups made through a Finger.
+    bool hash_index{false};
+    // Keep a counting Bloom filter of the keys, so get, contains and remove
+    // of most absent keys return without a search. Ignored when std::hash
+    // does not support K.
+    bool negative_filter{false};
+    // Lock the list in every operation. Turn off only when the owner already
+    // serializes all access to the list, as SortedSet does.
+    bool synchronized{true};
+};
+
+// The lock of a SkipList, which does nothing when the list is not
+// synchronized.
+class ListMutex {
+   public:
+    explicit ListMutex(bool enabled) : enabled_(enabled) {}
+
+    void lock() {
+        if (enabled_) mutex_.lock();
+    }
+    bool try_lock() { return !enabled_ || mutex_.try_lock(); }
+    void unlock() {
+        if (enabled_) mutex_.unlock();
+    }
+
+   private:
+    std::mutex mutex_;
+    bool enabled_;
 };
 
 template <typename K, typename V>
 class SkipList {
    public:
+    // max_level is only the initial ceiling on tower heights. From then on
+    // the ceiling follows log2 of the element count, growing and shrinking
+    // the header tower as the list does.
     explicit SkipList(uint8_t max_level,
-                      unsigned int seed = std::random_device{}())
-        : max_level_(max_level),
+                      unsigned int seed = std::random_device{}(),
+                      SkipListOptions options = {})
+        : options_(options),
+          max_level_(std::min(max_level, kMaxLevelLimit)),
           header_(std::make_unique<Node<K, V>>(K{}, V{}, max_level_)),
+          tail_(max_level_ + 1, header_.get()),
+          mutex_(options.synchronized),
           gen_(seed),
-          distribution_(0.5) {}
+          distribution_(0.5) {
+        header_->forward_[0].span_ = 1;
+        if (filtered()) filter_.reset(kFilterInitialCapacity);
+    }
+
+    ~SkipList() { release_run(std::move(header_->forward_[0].next_), nullptr); }
 
     SkipList(const SkipList&) = delete;
     SkipList& operator=(const SkipList&) = delete;
 
+    // A saved search path. Handing it back to put/get starts the search from
+    // where the previous one ended and climbs only as far as the distance to
+    // the new key requires. A finger outdated by changes made without it, or
+    // used with a smaller key, silently falls back to a search from the top.
+    // Like an iterator, it must not outlive the list it was used with.
+    class Finger {
+       private:
+        friend class SkipList;
+
+        const SkipList* owner_{nullptr};
+        uint64_t structure_version_{0};
+        std::vector<Node<K, V>*> preds_;
+        std::vector<size_t> ranks_;
+    };
+
     void put(const K& key, const V& value) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto predecessors = find_predecessors(key);
-        if (auto* exist = get_node_at_level_zero(predecessors[0], key)) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        if (options_.multimap) {
+            auto path = find_predecessors<true>(key);
+            insert_new_node(key, value, path.preds, path.ranks);
+            return;
+        }
+        if (auto* exist = index_find(key)) {
+            update_existing_node(exist, value);
+            return;
+        }
+        auto path = find_predecessors(key);
+        if (auto* exist = get_node_at_level_zero(path.preds[0], key)) {
+            update_existing_node(exist, value);
+        } else {
+            insert_new_node(key, value, path.preds, path.ranks);
+        }
+    }
+
+    void put(Finger& hint, const K& key, const V& value) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        if (options_.multimap) {
+            find_predecessors<true>(hint, key);
+            insert_new_node(key, value, hint.preds_, hint.ranks_);
+            hint.structure_version_ = structure_version_;
+            return;
+        }
+        find_predecessors(hint, key);
+        if (auto* exist = get_node_at_level_zero(hint.preds_[0], key)) {
+            update_existing_node(exist, value);
+        } else {
+            insert_new_node(key, value, hint.preds_, hint.ranks_);
+            hint.structure_version_ = structure_version_;
+        }
+    }
+
+    // Like put, but reports whether key was newly inserted.
+    bool insert_or_assign(const K& key, const V& value) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        auto path = find_predecessors(key);
+        if (auto* exist = get_node_at_level_zero(path.preds[0], key)) {
+            update_existing_node(exist, value);
+            return false;
+        }
+        insert_new_node(key, value, path.preds, path.ranks);
+        return true;
+    }
+
+    // Like put, but returns the value it replaced, if any.
+    std::optional<V> exchange(const K& key, const V& value) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        auto path = find_predecessors(key);
+        if (auto* exist = get_node_at_level_zero(path.preds[0], key)) {
+            std::optional<V> old(std::move(exist->value_));
             update_existing_node(exist, value);
+            return old;
+        }
+        insert_new_node(key, value, path.preds, path.ranks);
+        return std::nullopt;
+    }
+
+    // Read-modify-write in a single search: fn is called with a reference to
+    // the stored value, or to a value-initialised V that is then inserted if
+    // key is absent. Returns the resulting value.
+    template <typename F>
+    V upsert(const K& key, F&& fn) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        auto path = find_predecessors(key);
+        if (auto* exist = get_node_at_level_zero(path.preds[0], key)) {
+            fn(exist->value_);
+            return exist->value_;
+        }
+        V value{};
+        fn(value);
+        insert_new_node(key, value, path.preds, path.ranks);
+        return value;
+    }
+
+    // Stores merge_op(existing, operand), where existing points at the
+    // current value or is null when key is absent, like a RocksDB merge
+    // operator. Returns the merged value.
+    template <typename T, typename MergeOp>
+    V merge(const K& key, const T& operand, MergeOp&& merge_op) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        auto path = find_predecessors(key);
+        auto* exist = get_node_at_level_zero(path.preds[0], key);
+        V merged = merge_op(exist ? &exist->value_ : nullptr, operand);
+        if (exist) {
+            update_existing_node(exist, merged);
         } else {
-            insert_new_node(key, value, predecessors);
+            insert_new_node(key, merged, path.preds, path.ranks);
         }
+        return merged;
     }
 
     std::optional<V> get(const K& key) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<ListMutex> lock(mutex_);
         if (auto* node = find_node(key)) return node->value_;
         return std::nullopt;
     }
 
+    std::optional<V> get(Finger& hint, const K& key) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        find_predecessors(hint, key);
+        auto* node = get_target_node(hint.preds_[0], key);
+        if (!node) return std::nullopt;
+        if (options_.balance == Balance::kAccessBiased)
+            record_access(node, hint.preds_, hint.ranks_);
+        return node->value_;
+    }
+
+    // Looks up every key in one lock acquisition, interleaving the searches
+    // so that the memory stalls of one are overlapped with the others.
+    std::vector<std::optional<V>> get_many(const std::vector<K>& keys) {
+        std::vector<std::optional<V>> values(keys.size());
+        std::lock_guard<ListMutex> lock(mutex_);
+        if (indexed()) {
+            for (size_t i = 0; i < keys.size(); ++i)
+                if (auto* node = index_find(keys[i])) values[i] = node->value_;
+            return values;
+        }
+        interleaved_lookup(keys, values);
+        return values;
+    }
+
+    // Optimised for keys in ascending order: each search resumes from the
+    // previous search path and climbs only as high as the gap to the next key
+    // requires, so k sorted keys cost O(k log(n/k)). Unsorted input is still
+    // answered correctly by restarting from the header where the order breaks.
+    std::vector<std::optional<V>> get_many_sorted(const std::vector<K>& keys) {
+        std::vector<std::optional<V>> values(keys.size());
+        std::lock_guard<ListMutex> lock(mutex_);
+        sorted_lookup(keys, [&](size_t i, Node<K, V>* node) {
+            if (node) values[i] = node->value_;
+        });
+        return values;
+    }
+
     bool contains(const K& key) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<ListMutex> lock(mutex_);
         return find_node(key) != nullptr;
     }
 
+    // Values of all entries with key, in insertion order. Only a multimap
+    // has more than one.
+    std::vector<V> equal_range(const K& key) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        std::vector<V> values;
+        auto path = find_predecessors(key);
+        for (auto* node = path.preds[0]->forward_[0].next_.get();
+             node && !(key < node->key_); node = node->forward_[0].next_.get())
+            values.push_back(node->value_);
+        return values;
+    }
+
+    // Number of entries with key: the rank after the last of them less the
+    // rank before the first, O(log n) however many there are.
+    size_t count(const K& key) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        return find_predecessors<true>(key).ranks[0] -
+               find_predecessors(key).ranks[0];
+    }
+
+    std::vector<bool> contains_many_sorted(const std::vector<K>& keys) {
+        std::vector<bool> found(keys.size());
+        std::lock_guard<ListMutex> lock(mutex_);
+        sorted_lookup(keys, [&](size_t i, Node<K, V>* node) {
+            found[i] = node != nullptr;
+        });
+        return found;
+    }
+
     bool remove(const K& key) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto predecessors = find_predecessors(key);
-        auto* victim = get_node_at_level_zero(predecessors[0], key);
+        std::lock_guard<ListMutex> lock(mutex_);
+        if (filter_rejects(key)) return false;
+        if (indexed() && !index_find(key)) return false;
+        auto path = find_predecessors(key);
+        auto* victim = get_node_at_level_zero(path.preds[0], key);
+        count_filter_pass(victim != nullptr);
         if (!victim) return false;
 
-        delete_node(victim, predecessors);
+        const int height = static_cast<int>(victim->forward_.size()) - 1;
+        delete_node(victim, path.preds);
+        if (deterministic()) restore_gaps(path.preds, path.ranks, height + 1);
         adjust_max_level();
         return true;
     }
 
+    // Removes every key in [lo, hi) and returns how many there were. The run
+    // is spliced out of each level at once from the predecessors of lo and
+    // of hi, so the cost is two searches plus releasing the removed nodes.
+    // A deterministic list is rebuilt afterwards, O(n).
+    size_t remove_range(const K& lo, const K& hi) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        if (!(lo < hi)) return 0;
+        return splice_out(find_predecessors(lo), find_predecessors(hi));
+    }
+
+    // Removes the entries at 0-based positions [first, last), found through
+    // the link widths, and returns how many there were.
+    size_t remove_range_by_rank(size_t first, size_t last) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        last = std::min(last, element_count_);
+        if (first >= last) return 0;
+        return splice_out(rank_path(first), rank_path(last));
+    }
+
+    // Moves every key >= key into a new list and returns it. Only the link
+    // leaving the split point on each level is rewired, and the link widths
+    // give both sizes, so the cost is one search regardless of how much moves.
+    // Deterministic lists are both rebuilt afterwards, O(n), a hash index is
+    // split by moving the entries of the moved keys, and a negative filter is
+    // refilled on each side, O(n).
+    std::unique_ptr<SkipList> split_at(const K& key) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        auto right = make_sibling();
+        auto path = find_predecessors(key);
+        const size_t kept = path.ranks[0];
+        const size_t moved = element_count_ - kept;
+
+        for (int i = 0; i <= current_max_level_; ++i) {
+            auto& link = path.preds[i]->forward_[i];
+            auto& head = right->header_->forward_[i];
+            head.span_ = path.ranks[i] + link.span_ - kept;
+            head.next_ = std::move(link.next_);
+            link.span_ = kept + 1 - path.ranks[i];
+            if (head.next_) right->tail_[i] = tail_[i];
+            tail_[i] = path.preds[i];
+        }
+        hand_over_access_counts(right->first_node(), nullptr, *right);
+        right->current_max_level_ = current_max_level_;
+        right->element_count_ = moved;
+        right->adjust_max_level();
+        element_count_ = kept;
+        if (indexed()) {
+            for (auto* node = right->first_node(); node;
+                 node = node->forward_[0].next_.get()) {
+                index_erase(node);
+                right->index_insert(node);
+            }
+        }
+        rebuild_filter();
+        right->rebuild_filter();
+        ++structure_version_;
+        adjust_max_level();
+        if (deterministic()) {
+            rebuild_towers();
+            right->rebuild_towers();
+        }
+        return right;
+    }
+
+    // Appends all of other, whose keys must all be greater than the keys
+    // here, by linking each level's tail to the head of the same level in
+    // other, and leaves other empty. Returns false, changing nothing, when the
+    // key ranges overlap. A deterministic list is rebuilt afterwards, O(n), a
+    // hash index gains an entry per appended key, and a negative filter is
+    // refilled, O(n).
+    bool concat(SkipList& other) {
+        if (&other == this) return false;
+        std::scoped_lock lock(mutex_, other.mutex_);
+        auto* first = other.header_->forward_[0].next_.get();
+        if (!first) return true;
+        if (tail_[0] != header_.get() && !(tail_[0]->key_ < first->key_))
+            return false;
+        if (other.current_max_level_ > max_level_)
+            resize_max_level(other.current_max_level_);
+
+        const size_t count = element_count_;
+        const int top = std::max(current_max_level_, other.current_max_level_);
+        for (int i = 0; i <= top; ++i) {
+            auto& link = tail_[i]->forward_[i];
+            if (i > current_max_level_) link.span_ = count + 1;
+            if (i > other.current_max_level_) {
+                link.span_ += other.element_count_;
+                continue;
+            }
+            auto& head = other.header_->forward_[i];
+            const size_t rank = count + 1 - link.span_;
+            link.span_ = count - rank + head.span_;
+            link.next_ = std::move(head.next_);
+            head.span_ = 1;
+            tail_[i] = other.tail_[i];
+            other.tail_[i] = other.header_.get();
+        }
+        other.hand_over_access_counts(first, nullptr, *this);
+        current_max_level_ = static_cast<uint8_t>(top);
+        element_count_ += other.element_count_;
+        if (indexed()) {
+            for (auto* node = first; node; node = node->forward_[0].next_.get())
+                index_insert(node);
+        }
+        rebuild_filter();
+        if constexpr (IsHashable<K>::value) other.index_.clear();
+        if (other.filtered()) other.filter_.reset(kFilterInitialCapacity);
+        other.current_max_level_ = 0;
+        other.element_count_ = 0;
+        ++structure_version_;
+        ++other.structure_version_;
+        fit_max_level();
+        other.fit_max_level();
+        if (deterministic()) {
+            // Other may be as low as log4 of its size, and the rebuilt towers
+            // need about log2 of the combined size to keep the gap bounds.
+            uint8_t lvl = 0;
+            while (lvl < kMaxLevelLimit && (size_t{1} << lvl) < element_count_)
+                ++lvl;
+            if (lvl > max_level_) resize_max_level(lvl);
+            rebuild_towers();
+        }
+        return true;
+    }
+
+    // Set operations walk both level-0 chains in step. Where one side has a
+    // long run of keys the other lacks, the finger search on the other side
+    // passes the whole run through the upper levels. Where both lists hold a
+    // key, the result takes the value from this list.
+    std::unique_ptr<SkipList> set_union(const SkipList& other) {
+        auto locks = lock_with(other);
+        auto result = make_sibling();
+        auto* x = first_node();
+        auto* y = other.first_node();
+        while (x || y) {
+            if (x && (!y || !(y->key_ < x->key_))) {
+                if (y && !(x->key_ < y->key_)) y = y->forward_[0].next_.get();
+                result->append(x->key_, x->value_);
+                x = x->forward_[0].next_.get();
+            } else {
+                result->append(y->key_, y->value_);
+                y = y->forward_[0].next_.get();
+            }
+        }
+        return result;
+    }
+
+    std::unique_ptr<SkipList> set_intersection(const SkipList& other) {
+        auto locks = lock_with(other);
+        auto result = make_sibling();
+        auto mine = header_path();
+        auto theirs = other.header_path();
+        auto* x = first_node();
+        while (x) {
+            auto* y = other.seek(x->key_, theirs);
+            if (!y) break;
+            if (x->key_ < y->key_) {
+                x = seek(y->key_, mine);
+                continue;
+            }
+            result->append(x->key_, x->value_);
+            x = x->forward_[0].next_.get();
+        }
+        return result;
+    }
+
+    std::unique_ptr<SkipList> set_difference(const SkipList& other) {
+        auto locks = lock_with(other);
+        auto result = make_sibling();
+        auto theirs = other.header_path();
+        for (auto* x = first_node(); x; x = x->forward_[0].next_.get()) {
+            auto* y = other.seek(x->key_, theirs);
+            if (!y || x->key_ < y->key_) result->append(x->key_, x->value_);
+        }
+        return result;
+    }
+
+    // Copies in the entries of other whose keys are absent here, leaving
+    // existing values alone, and returns how many were added.
+    size_t merge(const SkipList& other) {
+        auto locks = lock_with(other);
+        if (&other == this) return 0;
+        auto path = header_path();
+        size_t added = 0;
+        for (auto* y = other.first_node(); y; y = y->forward_[0].next_.get()) {
+            traverse_from_finger(y->key_, path.preds, path.ranks);
+            if (get_node_at_level_zero(path.preds[0], y->key_)) continue;
+            insert_new_node(y->key_, y->value_, path.preds, path.ranks);
+            ++added;
+        }
+        return added;
+    }
+
+    // Walks the whole list to measure its towers, O(n).
+    BalanceStats balance_stats() {
+        std::lock_guard<ListMutex> lock(mutex_);
+        return collect_balance_stats();
+    }
+
+    // Whether the longest search exceeds factor times the hops of the longest
+    // search in a perfectly balanced list, about log2(n) + 1. Random tower
+    // heights stay within about three times that up to millions of keys;
+    // lists bent out of shape by skewed removals drift beyond it.
+    bool rebalance_advised(double factor = 4.0) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        auto stats = collect_balance_stats();
+        return stats.longest_search >
+               factor * (std::log2(static_cast<double>(stats.size) + 1) + 1);
+    }
+
+    // Rebuilds every tower deterministically in one pass over level 0: the
+    // node at rank r gets as many levels as r has trailing zero bits, which
+    // bounds every search at one hop per level. O(n).
+    void rebalance() {
+        std::lock_guard<ListMutex> lock(mutex_);
+        rebuild_towers();
+    }
+
+    // 0-based position of key, from the widths of the links the search
+    // crosses, or nothing if key is absent.
+    std::optional<size_t> rank(const K& key) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        auto path = find_predecessors(key);
+        if (!get_target_node(path.preds[0], key)) return std::nullopt;
+        return path.ranks[0];
+    }
+
+    // Entries with lo <= key < hi, in order.
+    std::vector<std::pair<K, V>> range(const K& lo, const K& hi) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        std::vector<std::pair<K, V>> entries;
+        auto path = find_predecessors(lo);
+        for (auto* node = path.preds[0]->forward_[0].next_.get();
+             node && node->key_ < hi; node = node->forward_[0].next_.get())
+            entries.emplace_back(node->key_, node->value_);
+        return entries;
+    }
+
+    // Entries at 0-based positions [first, last). Reaching first takes
+    // O(log n) hops along the link widths, with no key comparisons.
+    std::vector<std::pair<K, V>> range_by_rank(size_t first, size_t last) {
+        std::lock_guard<ListMutex> lock(mutex_);
+        std::vector<std::pair<K, V>> entries;
+        last = std::min(last, element_count_);
+        if (first >= last) return entries;
+        entries.reserve(last - first);
+        auto* node = rank_path(first).preds[0]->forward_[0].next_.get();
+        for (; first < last; ++first, node = node->forward_[0].next_.get())
+            entries.emplace_back(node->key_, node->value_);
+        return entries;
+    }
+
+    // Copies the contents into an immutable snapshot laid out for reading,
+    // which later changes to this list leave alone. O(n).
+    FrozenSkipList<K, V> freeze() const {
+        std::lock_guard<ListMutex> lock(mutex_);
+        std::vector<K> keys;
+        std::vector<V> values;
+        keys.reserve(element_count_);
+        values.reserve(element_count_);
+        for (auto* node = first_node(); node;
+             node = node->forward_[0].next_.get()) {
+            keys.push_back(node->key_);
+            values.push_back(node->value_);
+        }
+        return FrozenSkipList<K, V>(std::move(keys), std::move(values));
+    }
+
+    FilterStats filter_stats() const {
+        std::lock_guard<ListMutex> lock(mutex_);
+        return filter_stats_;
+    }
+
     size_t size() const { return element_count_; }
     bool empty() const { return element_count_ == 0; }
 
    private:
-    Node<K, V>* find_node(const K& key) { return traverse_to_level_zero(key); }
+    bool indexed() const {
+        if constexpr (IsHashable<K>::value) return options_.hash_index;
+        return false;
+    }
+
+    // The node for key through the hash index, or null when it is absent or
+    // there is no index. In a multimap the index holds the first of the
+    // entries with a key.
+    Node<K, V>* index_find(const K& key) const {
+        if constexpr (IsHashable<K>::value) {
+            if (!options_.hash_index) return nullptr;
+            auto it = index_.find(key);
+            return it == index_.end() ? nullptr : it->second;
+        }
+        return nullptr;
+    }
+
+    void index_insert(Node<K, V>* node) {
+        if constexpr (IsHashable<K>::value) {
+            if (options_.hash_index) index_.try_emplace(node->key_, node);
+        }
+    }
+
+    // Called before node is unlinked. A following entry with the same key
+    // takes its place in the index.
+    void index_erase(Node<K, V>* node) {
+        if constexpr (IsHashable<K>::value) {
+            if (!options_.hash_index) return;
+            auto it = index_.find(node->key_);
+            if (it == index_.end() || it->second != node) return;
+            auto* next = node->forward_[0].next_.get();
+            if (next && next->key_ == node->key_) {
+                it->second = next;
+            } else {
+                index_.erase(it);
+            }
+        }
+    }
+
+    bool filtered() const {
+        if constexpr (IsHashable<K>::value) return options_.negative_filter;
+        return false;
+    }
+
+    bool filter_rejects(const K& key) {
+        if constexpr (IsHashable<K>::value) {
+            if (options_.negative_filter && !filter_.may_contain(key)) {
+                ++filter_stats_.skipped;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void count_filter_pass(bool found) {
+        if (!filtered()) return;
+        ++(found ? filter_stats_.passed : filter_stats_.false_positives);
+    }
+
+    // Enters a newly linked node into the hash index and the filter. The
+    // filter is rebuilt at twice the size once the list outgrows it.
+    void track(Node<K, V>* node) {
+        index_insert(node);
+        if constexpr (IsHashable<K>::value) {
+            if (!options_.negative_filter) return;
+            if (element_count_ < filter_.capacity()) {
+                filter_.insert(node->key_);
+                return;
+            }
+            rebuild_filter();
+        }
+    }
+
+    // Refills the filter from level 0, sized for twice the element count.
+    void rebuild_filter() {
+        if constexpr (IsHashable<K>::value) {
+            if (!options_.negative_filter) return;
+            filter_.reset(2 * element_count_ + 2);
+            for (auto* x = first_node(); x; x = x->forward_[0].next_.get())
+                filter_.insert(x->key_);
+        }
+    }
+
+    // Withdraws a node about to be unlinked from the hash index, the filter
+    // and the access counts.
+    void untrack(Node<K, V>* node) {
+        index_erase(node);
+        if (!access_counts_.empty()) access_counts_.erase(node);
+        if constexpr (IsHashable<K>::value) {
+            if (options_.negative_filter) filter_.erase(node->key_);
+        }
+    }
+
+    // Moves the access counts of the nodes from first up to end, which now
+    // belong to to, over to it.
+    void hand_over_access_counts(Node<K, V>* first, const Node<K, V>* end,
+                                 SkipList& to) {
+        if (access_counts_.empty()) return;
+        for (auto* node = first; node != end;
+             node = node->forward_[0].next_.get()) {
+            auto it = access_counts_.find(node);
+            if (it == access_counts_.end()) continue;
+            to.access_counts_.insert(*it);
+            access_counts_.erase(it);
+        }
+    }
+
+    bool deterministic() const {
+        return options_.balance == Balance::kDeterministic;
+    }
+
+    // An empty list with the same settings, for results built from this one.
+    std::unique_ptr<SkipList> make_sibling() {
+        return std::make_unique<SkipList>(max_level_, gen_(), options_);
+    }
+
+    // rebalance() for callers already holding the lock. The result also meets
+    // the deterministic mode's gap bounds, as the ceiling is first raised to
+    // floor(log2 n) if it is lower.
+    void rebuild_towers() {
+        uint8_t top = 0;
+        while (top < kMaxLevelLimit && (size_t{2} << top) <= element_count_)
+            ++top;
+        if (top > max_level_) resize_max_level(top);
+
+        PredVec last(top + 1, header_.get());
+        RankVec last_rank(top + 1, 0);
+        size_t rank = 0;
+        for (auto* node = first_node(); node;
+             node = node->forward_[0].next_.get()) {
+            ++rank;
+            uint8_t lvl = 0;
+            while (lvl < top && !((rank >> lvl) & 1)) ++lvl;
+            node->forward_.resize(lvl + 1);
+            if (!access_counts_.empty()) {
+                auto it = access_counts_.find(node);
+                if (it != access_counts_.end()) it->second.base_level = lvl;
+            }
+            for (uint8_t i = 1; i <= lvl; ++i) {
+                last[i]->forward_[i] = {last[0]->forward_[0].next_,
+                                        rank - last_rank[i]};
+                last[i] = node;
+                last_rank[i] = rank;
+            }
+            last[0] = node;
+            last_rank[0] = rank;
+        }
+
+        for (uint8_t i = 0; i <= current_max_level_ || i <= top; ++i) {
+            if (i > top) {
+                header_->forward_[i].next_ = nullptr;
+                tail_[i] = header_.get();
+                continue;
+            }
+            if (i > 0) last[i]->forward_[i].next_ = nullptr;
+            last[i]->forward_[i].span_ = element_count_ + 1 - last_rank[i];
+            tail_[i] = last[i];
+        }
+        current_max_level_ = top;
+        ++structure_version_;
+    }
+
+    Node<K, V>* find_node(const K& key) {
+        if (filter_rejects(key)) return nullptr;
+        auto* node = search_node(key);
+        count_filter_pass(node != nullptr);
+        return node;
+    }
+
+    Node<K, V>* search_node(const K& key) {
+        if (indexed()) return index_find(key);
+        if (options_.balance != Balance::kAccessBiased)
+            return traverse_to_level_zero(key);
+        auto* node = options_.multimap ? traverse_to_level_zero(key)
+                                       : traverse_to_first_match(key);
+        if (node) record_access(node);
+        return node;
+    }
 
     using PredVec = std::vector<Node<K, V>*>;
-    PredVec find_predecessors(const K& key) {
-        PredVec preds(max_level_ + 1, nullptr);
-        traverse_and_collect_predecessors(key, preds);
-        return preds;
+    using RankVec = std::vector<size_t>;
+
+    // Recent lookups that found a node, and the height its tower had before
+    // they first raised it, which aging never lowers it below.
+    struct AccessCount {
+        uint32_t hits;
+        uint8_t base_level;
+    };
+    // The last node before a key on every level, with its rank: the number
+    // of level-0 steps from the header, which has rank 0.
+    struct SearchPath {
+        PredVec preds;
+        RankVec ranks;
+    };
+
+    // Keys past the current last one, as in time series or log sequence
+    // ingest, get the tail pointers as their predecessors without a search.
+    // With kPastEqual the path ends after the entries equal to key rather
+    // than before them, where a multimap adds another.
+    template <bool kPastEqual = false>
+    SearchPath find_predecessors(const K& key) {
+        if (tail_[0] != header_.get() &&
+            node_precedes<kPastEqual>(tail_[0], key, KeyPrefix<K>::make(key)))
+            return tail_path();
+        SearchPath path{PredVec(max_level_ + 1, nullptr),
+                        RankVec(max_level_ + 1, 0)};
+        traverse_and_collect_predecessors<kPastEqual>(key, path.preds,
+                                                      path.ranks);
+        return path;
+    }
+
+    SearchPath tail_path() const {
+        RankVec ranks(max_level_ + 1, 0);
+        for (int i = 0; i <= current_max_level_; ++i)
+            ranks[i] = element_count_ + 1 - tail_[i]->forward_[i].span_;
+        return {tail_, std::move(ranks)};
+    }
+
+    // Predecessors of the node at 0-based position pos, found by adding up
+    // link widths; pos == size() gives the predecessors of the end.
+    SearchPath rank_path(size_t pos) const {
+        SearchPath path{PredVec(max_level_ + 1, nullptr),
+                        RankVec(max_level_ + 1, 0)};
+        Node<K, V>* cur = header_.get();
+        size_t rank = 0;
+        for (int i = current_max_level_; i >= 0; --i) {
+            while (cur->forward_[i].next_ &&
+                   rank + cur->forward_[i].span_ <= pos) {
+                rank += cur->forward_[i].span_;
+                cur = cur->forward_[i].next_.get();
+            }
+            path.preds[i] = cur;
+            path.ranks[i] = rank;
+        }
+        return path;
+    }
+
+    // Unlinks the nodes between the predecessor paths first and last, on
+    // each level at once, and frees them.
+    size_t splice_out(const SearchPath& first, const SearchPath& last) {
+        const size_t removed = last.ranks[0] - first.ranks[0];
+        if (removed == 0) return 0;
+
+        auto run = first.preds[0]->forward_[0].next_;
+        auto* end = last.preds[0]->forward_[0].next_.get();
+        if (indexed() || filtered() || !access_counts_.empty()) {
+            for (auto* node = run.get(); node != end;
+                 node = node->forward_[0].next_.get())
+                untrack(node);
+        }
+        for (int i = 0; i <= current_max_level_; ++i) {
+            auto& link = first.preds[i]->forward_[i];
+            if (first.preds[i] == last.preds[i]) {
+                link.span_ -= removed;
+                continue;
+            }
+            const auto& after = last.preds[i]->forward_[i];
+            link.next_ = after.next_;
+            link.span_ =
+                last.ranks[i] + after.span_ - first.ranks[i] - removed;
+            if (tail_[i] == last.preds[i]) tail_[i] = first.preds[i];
+        }
+        release_run(std::move(run), end);
+        element_count_ -= removed;
+        ++structure_version_;
+        adjust_max_level();
+        if (deterministic()) rebuild_towers();
+        return removed;
+    }
+
+    // The predecessors of a key smaller than all others, to seed a finger.
+    SearchPath header_path() const {
+        return {PredVec(max_level_ + 1, header_.get()),
+                RankVec(max_level_ + 1, 0)};
+    }
+
+    // Returns the first node not less than key, advancing path, a finger
+    // left by a search for a key not greater than key.
+    Node<K, V>* seek(const K& key, SearchPath& path) const {
+        traverse_from_finger(key, path.preds, path.ranks);
+        return path.preds[0]->forward_[0].next_.get();
+    }
+
+    Node<K, V>* first_node() const { return header_->forward_[0].next_.get(); }
+
+    // The longest search is found in one pass: run[i] counts the hops taken
+    // on level i since the search last arrived from a level above, and a
+    // search ending at a node takes the sum of all runs. gap[i] counts the
+    // nodes of height exactly i - 1 since the last node reaching level i.
+    BalanceStats collect_balance_stats() const {
+        BalanceStats stats;
+        stats.size = element_count_;
+        stats.nodes_per_level.assign(current_max_level_ + 1, 0);
+        std::vector<size_t> run(current_max_level_ + 1, 0);
+        std::vector<size_t> gap(current_max_level_ + 2, 0);
+        size_t hops = 0;
+        for (auto* node = first_node(); node;
+             node = node->forward_[0].next_.get()) {
+            const size_t top = node->forward_.size() - 1;
+            for (size_t i = 0; i < top; ++i) {
+                ++stats.nodes_per_level[i];
+                hops -= run[i];
+                run[i] = 0;
+            }
+            for (size_t i = 1; i <= top; ++i) {
+                stats.widest_gap = std::max(stats.widest_gap, gap[i]);
+                gap[i] = 0;
+            }
+            ++stats.nodes_per_level[top];
+            ++run[top];
+            ++gap[top + 1];
+            ++hops;
+            stats.longest_search = std::max(stats.longest_search, hops);
+        }
+        for (size_t i = 1; i < gap.size(); ++i)
+            stats.widest_gap = std::max(stats.widest_gap, gap[i]);
+        return stats;
+    }
+
+    // Appends a key greater than every key in the list.
+    void append(const K& key, const V& value) {
+        auto path = tail_path();
+        insert_new_node(key, value, path.preds, path.ranks);
+    }
+
+    // Locks this list and other, only once if they are the same list.
+    std::pair<std::unique_lock<ListMutex>, std::unique_lock<ListMutex>>
+    lock_with(const SkipList& other) const {
+        std::unique_lock<ListMutex> mine(mutex_, std::defer_lock);
+        std::unique_lock<ListMutex> theirs;
+        if (&other == this) {
+            mine.lock();
+        } else {
+            theirs = std::unique_lock<ListMutex>(other.mutex_, std::defer_lock);
+            std::lock(mine, theirs);
+        }
+        return {std::move(mine), std::move(theirs)};
+    }
+
+    // Brings the finger's path to the predecessors of key. Any change made
+    // without this finger may have freed nodes on the path or shifted their
+    // ranks, so it forces a restart from the header.
+    template <bool kPastEqual = false>
+    void find_predecessors(Finger& finger, const K& key) {
+        if (finger.owner_ != this ||
+            finger.structure_version_ != structure_version_ ||
+            finger.preds_.size() != max_level_ + 1u ||
+            (finger.preds_[0] != header_.get() &&
+             !node_precedes<kPastEqual>(finger.preds_[0], key,
+                                        KeyPrefix<K>::make(key)))) {
+            finger.owner_ = this;
+            finger.structure_version_ = structure_version_;
+            finger.preds_.assign(max_level_ + 1, header_.get());
+            finger.ranks_.assign(max_level_ + 1, 0);
+        }
+        traverse_from_finger<kPastEqual>(key, finger.preds_, finger.ranks_);
     }
 
     Node<K, V>* traverse_to_level_zero(const K& key) {
+        const uint64_t prefix = KeyPrefix<K>::make(key);
         Node<K, V>* cur = header_.get();
         for (int i = current_max_level_; i >= 0; --i)
-            cur = move_forward_in_level(cur, i, key);
+            cur = move_forward_in_level(cur, i, key, prefix);
         return get_target_node(cur, key);
     }
 
-    void traverse_and_collect_predecessors(const K& key, PredVec& preds) {
+    // traverse_to_level_zero that stops on the first level where the next
+    // node holds key, so a raised tower shortens the search for its key. Not
+    // for a multimap, where an equal key with a lower tower may come first.
+    Node<K, V>* traverse_to_first_match(const K& key) {
+        const uint64_t prefix = KeyPrefix<K>::make(key);
         Node<K, V>* cur = header_.get();
         for (int i = current_max_level_; i >= 0; --i) {
-            cur = move_forward_in_level(cur, i, key);
+            cur = move_forward_in_level(cur, i, key, prefix);
+            const auto& link = cur->forward_[i];
+            if (link_matches(link, key)) return link.next_.get();
+        }
+        return nullptr;
+    }
+
+    template <bool kPastEqual = false>
+    void traverse_and_collect_predecessors(const K& key, PredVec& preds,
+                                           RankVec& ranks) {
+        const uint64_t prefix = KeyPrefix<K>::make(key);
+        Node<K, V>* cur = header_.get();
+        size_t rank = 0;
+        for (int i = current_max_level_; i >= 0; --i) {
+            cur = move_forward_in_level<kPastEqual>(cur, i, key, prefix, rank);
+            preds[i] = cur;
+            ranks[i] = rank;
+        }
+    }
+
+    template <typename F>
+    void sorted_lookup(const std::vector<K>& keys, F&& visit) {
+        PredVec preds(max_level_ + 1, header_.get());
+        RankVec ranks(max_level_ + 1, 0);
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (i > 0 && keys[i] < keys[i - 1]) {
+                std::fill(preds.begin(), preds.end(), header_.get());
+                std::fill(ranks.begin(), ranks.end(), 0);
+            }
+            traverse_from_finger(keys[i], preds, ranks);
+            visit(i, get_target_node(preds[0], keys[i]));
+        }
+    }
+
+    // Turns preds, the predecessors of some key not greater than key, into the
+    // predecessors of key. It climbs while the next node one level up is still
+    // short of key, then descends from there; levels above the climb already
+    // hold the right predecessors. Levels added to the list since preds was
+    // taken start out at the header.
+    template <bool kPastEqual = false>
+    void traverse_from_finger(const K& key, PredVec& preds,
+                              RankVec& ranks) const {
+        if (preds.size() < max_level_ + 1u) {
+            preds.resize(max_level_ + 1, header_.get());
+            ranks.resize(max_level_ + 1, 0);
+        }
+        const uint64_t prefix = KeyPrefix<K>::make(key);
+        int top = 0;
+        while (top < current_max_level_) {
+            if (!link_precedes<kPastEqual>(preds[top + 1]->forward_[top + 1],
+                                           key, prefix))
+                break;
+            ++top;
+        }
+
+        // Where the level above did not move, the old predecessor on this
+        // level is at least as far along; otherwise the new one above is.
+        Node<K, V>* cur = nullptr;
+        Node<K, V>* above = nullptr;
+        size_t rank = 0;
+        for (int i = top; i >= 0; --i) {
+            if (cur == above) {
+                cur = preds[i];
+                rank = ranks[i];
+            }
+            above = preds[i];
+            cur = move_forward_in_level<kPastEqual>(cur, i, key, prefix, rank);
             preds[i] = cur;
+            ranks[i] = rank;
+        }
+    }
+
+    struct Lookup {
+        Node<K, V>* cur;
+        Node<K, V>* nxt;
+        uint64_t prefix;
+        size_t index;
+        int lvl;
+        bool linked;
+    };
+
+    // Asynchronous memory access chaining: each step of a lookup touches only
+    // memory prefetched by its previous step, issues the prefetch for its next
+    // step and then yields to the other lookups in flight.
+    void interleaved_lookup(const std::vector<K>& keys,
+                            std::vector<std::optional<V>>& values) {
+        Lookup group[kLookupGroupSize];
+        size_t next = 0;
+        size_t active = 0;
+        for (; active < kLookupGroupSize && next < keys.size();
+             ++active, ++next)
+            start_lookup(group[active], keys[next], next);
+
+        while (active > 0) {
+            for (size_t i = 0; i < active;) {
+                Lookup& l = group[i];
+                if (!step_lookup(l, keys[l.index])) {
+                    ++i;
+                    continue;
+                }
+                if (l.nxt && l.nxt->key_ == keys[l.index])
+                    values[l.index] = l.nxt->value_;
+                if (next < keys.size()) {
+                    start_lookup(l, keys[next], next);
+                    ++next;
+                    ++i;
+                } else {
+                    l = group[--active];
+                }
+            }
         }
     }
 
-    Node<K, V>* move_forward_in_level(Node<K, V>* cur, int lvl, const K& key) {
-        while (cur->forward_[lvl] && cur->forward_[lvl]->key_ < key)
-            cur = cur->forward_[lvl].get();
+    void start_lookup(Lookup& l, const K& key, size_t index) {
+        l.cur = header_.get();
+        l.lvl = current_max_level_;
+        l.prefix = KeyPrefix<K>::make(key);
+        l.index = index;
+        l.linked = false;
+    }
+
+    // Returns true once the lookup has settled on level zero, leaving the
+    // candidate node in nxt.
+    bool step_lookup(Lookup& l, const K& key) {
+        if (!l.linked) {
+            l.nxt = l.cur->forward_[l.lvl].next_.get();
+            l.linked = true;
+        } else if (l.nxt && node_less(l.nxt, key, l.prefix)) {
+            l.cur = l.nxt;
+            l.linked = false;
+            prefetch(l.cur->forward_.data() + l.lvl);
+            return false;
+        } else if (l.lvl > 0) {
+            l.nxt = l.cur->forward_[--l.lvl].next_.get();
+        } else {
+            return true;
+        }
+        prefetch(l.nxt);
+        return false;
+    }
+
+    Node<K, V>* move_forward_in_level(Node<K, V>* cur, int lvl, const K& key,
+                                      uint64_t prefix) const {
+        size_t rank = 0;
+        return move_forward_in_level(cur, lvl, key, prefix, rank);
+    }
+
+    template <bool kPastEqual = false>
+    Node<K, V>* move_forward_in_level(Node<K, V>* cur, int lvl, const K& key,
+                                      uint64_t prefix, size_t& rank) const {
+        if constexpr (Node<K, V>::kCachesKeys) {
+            for (auto* link = &cur->forward_[lvl];
+                 link_precedes<kPastEqual>(*link, key, prefix);
+                 link = &cur->forward_[lvl]) {
+                rank += link->span_;
+                cur = link->next_.get();
+            }
+            return cur;
+        }
+        while (auto* nxt = cur->forward_[lvl].next_.get()) {
+            prefetch_tower(nxt->forward_.data() + lvl);
+            if (!node_precedes<kPastEqual>(nxt, key, prefix)) break;
+            rank += cur->forward_[lvl].span_;
+            cur = nxt;
+        }
         return cur;
     }
 
+    static void prefetch(const void* addr) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(addr);
+#else
+        (void)addr;
+#endif
+    }
+
+    // prefetch, for the single-key searches MOMU_SKIP_LIST_PREFETCH governs.
+    static void prefetch_tower(const void* addr) {
+#if MOMU_SKIP_LIST_PREFETCH
+        prefetch(addr);
+#else
+        (void)addr;
+#endif
+    }
+
+    static bool node_less(const Node<K, V>* node, const K& key,
+                          uint64_t prefix) {
+        if constexpr (KeyPrefix<K>::kEnabled) {
+            if (node->prefix_ != prefix) return node->prefix_ < prefix;
+        }
+        return node->key_ < key;
+    }
+
+    // Whether link leads to a node that precedes key, as node_precedes. Cached
+    // keys answer without loading the node, and the sentinel in a null link
+    // is never less than key.
+    template <bool kPastEqual>
+    static bool link_precedes(const typename Node<K, V>::Link& link,
+                              const K& key, uint64_t prefix) {
+        if constexpr (!Node<K, V>::kCachesKeys) {
+            return link.next_ && node_precedes<kPastEqual>(link.next_.get(),
+                                                           key, prefix);
+        } else if constexpr (!kPastEqual) {
+            return link.next_.key() < key;
+        } else {
+            return !(key < link.next_.key()) && link.next_;
+        }
+    }
+
+    // Whether link leads to a node holding key.
+    static bool link_matches(const typename Node<K, V>::Link& link,
+                             const K& key) {
+        if constexpr (Node<K, V>::kCachesKeys) {
+            return link.next_.key() == key && link.next_;
+        } else {
+            return link.next_ && link.next_->key_ == key;
+        }
+    }
+
+    // node_less, or with kPastEqual whether node is not greater than key.
+    template <bool kPastEqual>
+    static bool node_precedes(const Node<K, V>* node, const K& key,
+                              uint64_t prefix) {
+        if constexpr (!kPastEqual) {
+            return node_less(node, key, prefix);
+        } else {
+            if constexpr (KeyPrefix<K>::kEnabled) {
+                if (node->prefix_ != prefix) return node->prefix_ < prefix;
+            }
+            return !(key < node->key_);
+        }
+    }
+
     Node<K, V>* get_target_node(Node<K, V>* pred, const K& key) {
-        auto* nxt = pred->forward_[0].get();
+        auto* nxt = pred->forward_[0].next_.get();
         return (nxt && nxt->key_ == key) ? nxt : nullptr;
     }
 
     Node<K, V>* get_node_at_level_zero(Node<K, V>* pred, const K& key) {
-        auto* nxt = pred->forward_[0].get();
+        auto* nxt = pred->forward_[0].next_.get();
         return (nxt && nxt->key_ == key) ? nxt : nullptr;
     }
 
@@ -117,30 +1411,310 @@ class SkipList {
         node->value_ = value;
     }
 
-    void insert_new_node(const K& key, const V& value, const PredVec& preds) {
-        uint8_t lvl = generate_random_level();
-        PredVec mutable_preds = preds;
-        adjust_max_level_for_insertion(lvl, mutable_preds);
+    // Links a new node in after preds, which must be its predecessors and
+    // their ranks, and keeps them so for the next key after it.
+    void insert_new_node(const K& key, const V& value, PredVec& preds,
+                         RankVec& ranks) {
+        uint8_t lvl = deterministic() ? 0 : generate_random_level();
+        adjust_max_level_for_insertion(lvl, preds, ranks);
 
+        const size_t rank = ranks[0] + 1;
         auto new_node = std::make_shared<Node<K, V>>(key, value, lvl);
         for (uint8_t i = 0; i <= lvl; ++i) {
-            new_node->forward_[i] = mutable_preds[i]->forward_[i];
-            mutable_preds[i]->forward_[i] = new_node;
+            auto& link = preds[i]->forward_[i];
+            const size_t span = rank - ranks[i];
+            new_node->forward_[i] = {std::move(link.next_),
+                                     link.span_ + 1 - span};
+            link = {new_node, span};
+            if (!new_node->forward_[i].next_) tail_[i] = new_node.get();
         }
+        for (int i = lvl + 1; i <= current_max_level_; ++i)
+            ++preds[i]->forward_[i].span_;
+        track(new_node.get());
         ++element_count_;
+        ++structure_version_;
+        fit_max_level();
+        if (deterministic()) restore_gaps(preds, ranks, 1);
     }
 
     void delete_node(Node<K, V>* node, const PredVec& preds) {
+        untrack(node);
         for (uint8_t i = 0; i <= current_max_level_; ++i) {
-            if (preds[i]->forward_[i].get() == node)
-                preds[i]->forward_[i] = node->forward_[i];
+            auto& link = preds[i]->forward_[i];
+            if (link.next_.get() == node) {
+                link.span_ += node->forward_[i].span_ - 1;
+                link.next_ = node->forward_[i].next_;
+            } else {
+                --link.span_;
+            }
+            if (tail_[i] == node) tail_[i] = preds[i];
         }
         --element_count_;
+        ++structure_version_;
+    }
+
+    // Deterministic mode keeps every gap, the nodes of height exactly i - 1
+    // between a node of height >= i and the next one, at one to three nodes.
+    // Only the gap before the end of a level may be empty. An insertion or
+    // removal changes the gaps on its search path, so they are repaired
+    // bottom up from preds: a full gap promotes its middle node, an empty one
+    // demotes a neighbour, and either may carry a change one level higher.
+    // Levels up to through are checked unconditionally.
+    void restore_gaps(PredVec& preds, RankVec& ranks, int through) {
+        bool carry = false;
+        for (int i = 1; (i <= through || carry) && i <= current_max_level_ + 1;
+             ++i) {
+            if (i > current_max_level_) {
+                preds.resize(std::max<size_t>(preds.size(), i + 1));
+                ranks.resize(preds.size());
+                preds[i] = header_.get();
+                ranks[i] = 0;
+            }
+            carry = restore_gap(preds, ranks, i);
+        }
+    }
+
+    // Repairs the level-i gap after preds[i] and returns whether the number
+    // of nodes reaching level i changed.
+    bool restore_gap(PredVec& preds, RankVec& ranks, int i) {
+        auto* owner = preds[i];
+        size_t size = gap_size(owner, i);
+        if (size > 3) {
+            promote(preds, ranks, i, (size + 1) / 2);
+            return true;
+        }
+        if (size > 0 || i > current_max_level_) return false;
+
+        auto* next = owner->forward_[i].next_.get();
+        if (!next) return false;
+        if (next->forward_.size() == i + 1u) {
+            demote(owner, i);
+        } else if (owner != header_.get() && owner->forward_.size() == i + 1u) {
+            Node<K, V>* pred = header_.get();
+            size_t rank = 0;
+            if (i < current_max_level_) {
+                pred = preds[i + 1];
+                rank = ranks[i + 1];
+            }
+            while (pred->forward_[i].next_.get() != owner) {
+                rank += pred->forward_[i].span_;
+                pred = pred->forward_[i].next_.get();
+            }
+            demote(pred, i);
+            preds[i] = pred;
+            ranks[i] = rank;
+        } else {
+            return false;
+        }
+        size = gap_size(preds[i], i);
+        if (size > 3) {
+            promote(preds, ranks, i, (size + 1) / 2);
+            return false;
+        }
+        return true;
+    }
+
+    size_t gap_size(Node<K, V>* owner, int i) const {
+        const Node<K, V>* end = nullptr;
+        if (static_cast<size_t>(i) < owner->forward_.size())
+            end = owner->forward_[i].next_.get();
+        size_t size = 0;
+        for (auto* x = owner->forward_[i - 1].next_.get(); x != end;
+             x = x->forward_[i - 1].next_.get())
+            ++size;
+        return size;
+    }
+
+    // Raises the nth node of the level-i gap after preds[i] to level i,
+    // opening a new top level if needed, and moves preds[i] onto it when it
+    // lies before the position preds describes.
+    void promote(PredVec& preds, RankVec& ranks, int i, size_t nth) {
+        if (i > current_max_level_) {
+            if (i > max_level_) {
+                if (max_level_ >= kMaxLevelLimit) return;
+                resize_max_level(static_cast<uint8_t>(i));
+            }
+            header_->forward_[i] = {nullptr, element_count_ + 1};
+            current_max_level_ = static_cast<uint8_t>(i);
+        }
+        auto* owner = preds[i];
+        bool after = owner == preds[i - 1];
+        const auto* node = &owner->forward_[i - 1].next_;
+        size_t span = owner->forward_[i - 1].span_;
+        for (size_t n = 1; n < nth; ++n) {
+            after = after || node->get() == preds[i - 1];
+            auto& link = (*node)->forward_[i - 1];
+            span += link.span_;
+            node = &link.next_;
+        }
+
+        auto promoted = *node;
+        auto& link = owner->forward_[i];
+        promoted->forward_.push_back(
+            {std::move(link.next_), link.span_ - span});
+        link = {promoted, span};
+        if (!promoted->forward_[i].next_) tail_[i] = promoted.get();
+        if (!after) {
+            preds[i] = promoted.get();
+            ranks[i] += span;
+        }
+    }
+
+    // Lowers the level-i successor of pred, whose tower ends at level i.
+    void demote(Node<K, V>* pred, int i) {
+        auto& link = pred->forward_[i];
+        auto* node = link.next_.get();
+        link.span_ += node->forward_[i].span_;
+        link.next_ = std::move(node->forward_[i].next_);
+        node->forward_.pop_back();
+        if (tail_[i] == node) tail_[i] = pred;
+    }
+
+    // Samples one in kAccessSamplePeriod lookups that found a node, whose
+    // predecessors and their ranks are preds, and raises the node's tower to
+    // log2 of the lookups its samples stand for, so a key taking a fraction p
+    // of recent lookups ends up about log2(1/p) levels below the top. Every n
+    // lookups the counts are aged.
+    void record_access(Node<K, V>* node, PredVec& preds, RankVec& ranks) {
+        if (++accesses_ % kAccessSamplePeriod == 0) {
+            const uint8_t lvl = count_access(node);
+            if (lvl + 1u > node->forward_.size())
+                raise_tower(node, lvl, preds, ranks);
+        }
+        if (accesses_ >= std::max(element_count_, kAgingMinPeriod))
+            age_access_counts();
+    }
+
+    // record_access for a lookup that kept no path. The path is searched for
+    // only when the tower has to rise, once per doubling of the count.
+    void record_access(Node<K, V>* node) {
+        if (++accesses_ % kAccessSamplePeriod == 0) {
+            const uint8_t lvl = count_access(node);
+            if (lvl + 1u > node->forward_.size()) {
+                auto path = find_predecessors(node->key_);
+                raise_tower(node, lvl, path.preds, path.ranks);
+            }
+        }
+        if (accesses_ >= std::max(element_count_, kAgingMinPeriod))
+            age_access_counts();
+    }
+
+    // Bumps node's count and returns the level it earns.
+    uint8_t count_access(Node<K, V>* node) {
+        const auto base = static_cast<uint8_t>(node->forward_.size() - 1);
+        auto& count = access_counts_.try_emplace(node, AccessCount{0, base})
+                          .first->second;
+        if (count.hits < UINT32_MAX) ++count.hits;
+        return std::min(access_level(count.hits), max_level_);
+    }
+
+    void raise_tower(Node<K, V>* node, uint8_t lvl, PredVec& preds,
+                     RankVec& ranks) {
+        adjust_max_level_for_insertion(lvl, preds, ranks);
+        const auto& self = preds[0]->forward_[0].next_;
+        const size_t rank = ranks[0] + 1;
+        for (uint8_t i = node->forward_.size(); i <= lvl; ++i) {
+            auto& link = preds[i]->forward_[i];
+            const size_t span = rank - ranks[i];
+            node->forward_.push_back(
+                {std::move(link.next_), link.span_ - span});
+            link = {self, span};
+            if (!node->forward_[i].next_) tail_[i] = node;
+        }
+        ++structure_version_;
+    }
+
+    // log2 of the lookups that hits samples stand for. A single sample earns
+    // nothing, so a one-off lookup of a cold key raises no tower.
+    static uint8_t access_level(uint32_t hits) {
+        if (hits < 2) return 0;
+        uint8_t lvl = kAccessSampleShift;
+        while (hits >>= 1) ++lvl;
+        return lvl;
+    }
+
+    // Halves every count and lowers each tower standing more than one level
+    // above what its count still earns, but never below its base level. The
+    // slack keeps a steadily hot key from being lowered and raised again
+    // every period. A count that reaches zero is dropped, its tower back at
+    // the base level. One pass over the counts, not over the list.
+    void age_access_counts() {
+        accesses_ = 0;
+        bool lowered = false;
+        for (auto it = access_counts_.begin(); it != access_counts_.end();) {
+            auto* node = it->first;
+            auto& count = it->second;
+            count.hits /= 2;
+            const uint8_t earned = access_level(count.hits) + 1;
+            const size_t keep =
+                (count.hits ? std::max(count.base_level, earned)
+                            : count.base_level) + size_t{1};
+            if (keep < node->forward_.size()) {
+                lower_tower(node, keep);
+                lowered = true;
+            }
+            it = count.hits ? std::next(it) : access_counts_.erase(it);
+        }
+        if (lowered) {
+            ++structure_version_;
+            adjust_max_level();
+        }
+    }
+
+    // Cuts node's tower down to height levels.
+    void lower_tower(Node<K, V>* node, size_t height) {
+        auto path = find_predecessors(node->key_);
+        for (size_t i = node->forward_.size() - 1; i >= height; --i) {
+            auto* pred = path.preds[i];
+            while (pred->forward_[i].next_.get() != node)
+                pred = pred->forward_[i].next_.get();
+            demote(pred, static_cast<int>(i));
+        }
+    }
+
+    // Frees a detached run of nodes up to, not including, end. Towers are
+    // cleared front to back so that releasing a long run does not recurse
+    // through the chain of shared_ptr destructors.
+    void release_run(std::shared_ptr<Node<K, V>> node,
+                     const Node<K, V>* end) {
+        while (node.get() != end) {
+            auto next = std::move(node->forward_[0].next_);
+            node->forward_.clear();
+            node = std::move(next);
+        }
     }
 
     void adjust_max_level() {
-        while (current_max_level_ > 0 && !header_->forward_[current_max_level_])
+        while (current_max_level_ > 0 &&
+               !header_->forward_[current_max_level_].next_)
             --current_max_level_;
+        fit_max_level();
+    }
+
+    // Keeps the ceiling near log2 of the element count: it grows as soon as
+    // the count passes 2^max_level_, as far as a bulk operation needs, and
+    // shrinks, never below the tallest tower, once the count drops under a
+    // quarter of that.
+    void fit_max_level() {
+        if (max_level_ < kMaxLevelLimit &&
+            element_count_ > (size_t{1} << max_level_)) {
+            uint8_t lvl = max_level_ + 1;
+            while (lvl < kMaxLevelLimit && element_count_ > (size_t{1} << lvl))
+                ++lvl;
+            resize_max_level(lvl);
+        } else if (max_level_ > current_max_level_ && max_level_ >= 2 &&
+                   element_count_ < (size_t{1} << (max_level_ - 2))) {
+            uint8_t lvl = 0;
+            while ((size_t{1} << lvl) < element_count_) ++lvl;
+            resize_max_level(std::max(lvl, current_max_level_));
+        }
+    }
+
+    void resize_max_level(uint8_t lvl) {
+        max_level_ = lvl;
+        header_->forward_.resize(max_level_ + 1);
+        tail_.resize(max_level_ + 1, header_.get());
+        ++structure_version_;
     }
 
     uint8_t generate_random_level() {
@@ -153,20 +1727,51 @@ class SkipList {
 
     bool get_half_probability() { return distribution_(gen_); }
 
-    void adjust_max_level_for_insertion(uint8_t lvl, PredVec& preds) {
+    void adjust_max_level_for_insertion(uint8_t lvl, PredVec& preds,
+                                        RankVec& ranks) {
         if (lvl > current_max_level_) {
-            for (uint8_t i = current_max_level_ + 1; i <= lvl; ++i)
+            for (uint8_t i = current_max_level_ + 1; i <= lvl; ++i) {
                 preds[i] = header_.get();
+                ranks[i] = 0;
+                header_->forward_[i].span_ = element_count_ + 1;
+            }
             current_max_level_ = lvl;
         }
     }
 
+    static constexpr size_t kLookupGroupSize = 8;
+    static constexpr uint8_t kMaxLevelLimit = 32;
+    static constexpr size_t kAgingMinPeriod = 1024;
+    static constexpr uint8_t kAccessSampleShift = 4;
+    static constexpr size_t kAccessSamplePeriod = size_t{1}
+                                                  << kAccessSampleShift;
+    static constexpr size_t kFilterInitialCapacity = 1024;
+
+    SkipListOptions options_;
     uint8_t max_level_;
     uint8_t current_max_level_{0};
     std::unique_ptr<Node<K, V>> header_;
+    // Last node on each level, or the header where a level is empty.
+    PredVec tail_;
     size_t element_count_{0};
+    // Bumped whenever links change, so fingers can tell whether their saved
+    // path is still usable.
+    uint64_t structure_version_{0};
+    // Lookups counted since the access counts were last aged.
+    size_t accesses_{0};
+    // Per-node counts of the access-biased mode, kept beside the nodes so the
+    // other modes pay nothing for them. Only nodes found since their count
+    // last aged to zero have one.
+    std::unordered_map<Node<K, V>*, AccessCount> access_counts_;
+    // Key to node, kept only with the hash_index option.
+    std::conditional_t<IsHashable<K>::value,
+                       std::unordered_map<K, Node<K, V>*>, std::tuple<>>
+        index_;
+    // Keys, kept only with the negative_filter option.
+    CountingBloomFilter<K> filter_;
+    FilterStats filter_stats_;
 
-    mutable std::mutex mutex_;
+    mutable ListMutex mutex_;
     std::mt19937 gen_;
     std::bernoulli_distribution distribution_;
 };
@@ -0,0 +1,164 @@
+#ifndef MOMU_SORTED_SET_H
+#define MOMU_SORTED_SET_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "skip_list.h"
+
+namespace momu {
+namespace skip_list {
+
+// A sorted set in the manner of Redis' zset: each member has a score, and
+// members are ordered by (score, member). A hash map from member to score
+// answers zscore in O(1) and finds a member's entry in the skip list, whose
+// link widths give ranks. One mutex covers both structures; the skip list
+// is built unsynchronized so no operation takes a second lock.
+//
+// Ranks are 0-based. As in Redis, a negative rank counts from the end, so -1
+// is the member with the highest score.
+//
+// Member must be default-constructible: zrangebyscore builds its bounds from
+// Member{}.
+template <typename Member, typename Score = double>
+class SortedSet {
+   public:
+    explicit SortedSet(uint8_t max_level = 16,
+                       unsigned int seed = std::random_device{}())
+        : list_(max_level, seed, unsynchronized()) {}
+
+    SortedSet(const SortedSet&) = delete;
+    SortedSet& operator=(const SortedSet&) = delete;
+
+    // Adds member with score, or moves it to score. Returns whether member
+    // was newly added. As in Redis a NaN score is rejected, leaving the set
+    // unchanged: NaN compares equal to every score, so a single NaN entry
+    // would break the (score, member) order for all members.
+    bool zadd(const Member& member, Score score) {
+        if constexpr (std::is_floating_point_v<Score>)
+            if (std::isnan(score)) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto [it, added] = scores_.try_emplace(member, score);
+        if (!added) {
+            if (!(it->second < score) && !(score < it->second)) return false;
+            list_.remove(Entry{it->second, 0, member});
+            it->second = score;
+        }
+        list_.put(Entry{score, 0, member}, true);
+        return added;
+    }
+
+    bool zrem(const Member& member) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = scores_.find(member);
+        if (it == scores_.end()) return false;
+        list_.remove(Entry{it->second, 0, member});
+        scores_.erase(it);
+        return true;
+    }
+
+    std::optional<Score> zscore(const Member& member) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = scores_.find(member);
+        if (it == scores_.end()) return std::nullopt;
+        return it->second;
+    }
+
+    std::optional<size_t> zrank(const Member& member) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = scores_.find(member);
+        if (it == scores_.end()) return std::nullopt;
+        return list_.rank(Entry{it->second, 0, member});
+    }
+
+    // Members with min <= score <= max, by ascending score.
+    std::vector<std::pair<Member, Score>> zrangebyscore(Score min, Score max) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return members(list_.range(Entry{min, -1, Member{}},
+                                   Entry{max, 1, Member{}}));
+    }
+
+    // Members ranked start to stop, both included.
+    std::vector<std::pair<Member, Score>> zrange(int64_t start, int64_t stop) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto [first, last] = rank_range(start, stop);
+        return members(list_.range_by_rank(first, last));
+    }
+
+    // Removes the members ranked start to stop, both included, and returns
+    // how many there were.
+    size_t zremrangebyrank(int64_t start, int64_t stop) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto [first, last] = rank_range(start, stop);
+        for (const auto& entry : list_.range_by_rank(first, last))
+            scores_.erase(entry.first.member);
+        return list_.remove_range_by_rank(first, last);
+    }
+
+    size_t zcard() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return scores_.size();
+    }
+
+   private:
+    static SkipListOptions unsynchronized() {
+        SkipListOptions options;
+        options.synchronized = false;
+        return options;
+    }
+
+    struct Entry {
+        Score score{};
+        // -1 or 1 make a search bound that sorts before or after every member
+        // with the same score; stored entries have 0.
+        int8_t bound{0};
+        Member member{};
+
+        bool operator<(const Entry& other) const {
+            if (score < other.score) return true;
+            if (other.score < score) return false;
+            if (bound != 0 || other.bound != 0) return bound < other.bound;
+            return member < other.member;
+        }
+        bool operator==(const Entry& other) const {
+            return !(*this < other) && !(other < *this);
+        }
+    };
+
+    // Turns Redis-style inclusive ranks, negative ones counting from the end,
+    // into a half-open range of 0-based positions.
+    std::pair<size_t, size_t> rank_range(int64_t start, int64_t stop) const {
+        const auto size = static_cast<int64_t>(scores_.size());
+        if (start < 0) start = std::max<int64_t>(start + size, 0);
+        if (stop < 0) stop += size;
+        if (start > stop || start >= size) return {0, 0};
+        return {static_cast<size_t>(start),
+                static_cast<size_t>(std::min(stop, size - 1)) + 1};
+    }
+
+    static std::vector<std::pair<Member, Score>> members(
+        const std::vector<std::pair<Entry, bool>>& entries) {
+        std::vector<std::pair<Member, Score>> result;
+        result.reserve(entries.size());
+        for (const auto& entry : entries)
+            result.emplace_back(entry.first.member, entry.first.score);
+        return result;
+    }
+
+    SkipList<Entry, bool> list_;
+    std::unordered_map<Member, Score> scores_;
+    mutable std::mutex mutex_;
+};
+
+}  // namespace skip_list
+}  // namespace momu
+
+#endif  // MOMU_SORTED_SET_H